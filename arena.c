@@ -0,0 +1,89 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#include <stdlib.h>
+#include "arena.h"
+
+#define ALIGNMENT   (sizeof(void*) > sizeof(double) ? sizeof(void*) : sizeof(double))
+
+struct ArenaBlock {
+    ArenaBlock* next;
+    size_t      used;
+    size_t      capacity;
+    // data follows
+};
+
+static size_t align(size_t n)
+{
+    return (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+static char* block_data(ArenaBlock* b)
+{
+    return (char*)b + align(sizeof(ArenaBlock));
+}
+
+void arena_init(Arena* arena, size_t block_size)
+{
+    *arena = (Arena) {NULL, block_size, 0};
+}
+
+void* arena_alloc(Arena* arena, size_t size)
+{
+    size = align(size ? size : 1);
+    ArenaBlock* b = arena->blocks;
+    if (!b || b->capacity - b->used < size) {
+        size_t capacity = size > arena->block_size / 4 ? size : arena->block_size;
+        b = calloc(1, align(sizeof(ArenaBlock)) + capacity);
+        if (!b)
+            return NULL;
+        b->capacity = capacity;
+        if (capacity != arena->block_size && arena->blocks) {
+            // keep filling the current block, the big one is full anyway
+            b->next = arena->blocks->next;
+            arena->blocks->next = b;
+        } else {
+            b->next = arena->blocks;
+            arena->blocks = b;
+        }
+    }
+    void* p = block_data(b) + b->used;
+    b->used += size;
+    arena->size += size;
+    return p;
+}
+
+void arena_merge(Arena* dst, Arena* src)
+{
+    if (!src->blocks)
+        return;
+    // src blocks go behind the current block of dst so it can still be filled
+    ArenaBlock* last = src->blocks;
+    while (last->next)
+        last = last->next;
+    if (dst->blocks) {
+        last->next = dst->blocks->next;
+        dst->blocks->next = src->blocks;
+    } else {
+        dst->blocks = src->blocks;
+    }
+    dst->size += src->size;
+    src->blocks = NULL;
+    src->size = 0;
+}
+
+void arena_free(Arena* arena)
+{
+    ArenaBlock* b = arena->blocks;
+    while (b) {
+        ArenaBlock* next = b->next;
+        free(b);
+        b = next;
+    }
+    arena->blocks = NULL;
+    arena->size = 0;
+}
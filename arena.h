@@ -0,0 +1,34 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// bump allocator, memory is only released all at once with arena_free()
+// not thread safe
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct Arena {
+    ArenaBlock* blocks;             // current block first
+    size_t      block_size;
+    size_t      size;               // bytes handed out
+} Arena;
+
+void arena_init(Arena* arena, size_t block_size);
+
+// zero filled and aligned for any type, requests larger than a block get their own
+void* arena_alloc(Arena* arena, size_t size);
+
+// move all blocks of src to dst, src is empty afterwards
+void arena_merge(Arena* dst, Arena* src);
+
+void arena_free(Arena* arena);
+
+#endif
@@ -0,0 +1,605 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+// headless benchmark, run with "make bench"
+// generates synthetic application dirs and times the hot paths of fehlstart.c
+// results are printed as json to stdout, progress goes to stderr
+
+#define _GNU_SOURCE             // clock_gettime, mkdtemp
+#define FEHLSTART_BENCH         // leaves out main() of fehlstart.c
+
+#include "fehlstart.c"
+#include <dirent.h>
+
+#define BENCH_MAX_SIZES     8
+#define BENCH_QUERIES       200 // typed words per corpus
+#define BENCH_QUERY_LEN     6   // keystrokes per word
+#define BENCH_ICONS         100 // icons loaded per type
+#define BENCH_CHECKS        200 // queries whose narrowed results are compared with full scans
+#define BENCH_ICON_SIZE     48
+
+enum {ICON_THEME, ICON_PNG, ICON_XPM, ICON_SVG, ICON_TYPES};
+
+static const char* icon_type_names[ICON_TYPES] = {"theme", "png", "xpm", "svg"};
+
+typedef struct {
+    unsigned    sizes[BENCH_MAX_SIZES];
+    unsigned    size_count;
+    unsigned    runs;
+    bool        fuzzy;
+    bool        keep;               // don't delete the generated files
+} BenchOptions;
+
+static const char* words[] = {
+    "text", "editor", "image", "viewer", "music", "player", "video", "terminal", "file", "manager",
+    "office", "writer", "calc", "draw", "mail", "client", "web", "browser", "system", "monitor",
+    "settings", "disk", "usage", "analyzer", "archive", "calendar", "contacts", "maps", "weather",
+    "photos", "screenshot", "recorder", "sound", "mixer", "network", "printer", "scanner", "font",
+    "character", "map", "document", "reader", "notes", "tasks", "clock", "calculator", "dictionary",
+    "chat", "voice", "remote", "desktop", "backup", "software", "update", "package", "installer",
+    "python", "java", "console", "shell", "debugger", "profiler", "designer", "studio", "paint",
+    "vector", "graphics", "3d", "modeler", "game", "chess", "mines", "solitaire", "tetris", "sudoku",
+    "firefox", "thunderbird", "gimp", "inkscape", "blender", "vlc", "audacity", "kdenlive", "krita",
+    "libreoffice", "evince", "nautilus", "dolphin", "thunar", "xterm", "konsole", "gedit", "kate",
+};
+
+static uint64_t rng_state = 0x853c49e6748fea9bull;
+
+static uint32_t rng(void)
+{
+    // xorshift64*, fixed seed so runs are comparable
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 0x2545f4914f6cdd1dull) >> 32);
+}
+
+static double rng_unit(void)
+{
+    return rng() / 4294967296.0;
+}
+
+// a few words are very common, most are rare, like real application names
+static const char* random_word(void)
+{
+    double u = rng_unit();
+    return words[(unsigned)(u * u * COUNTOF(words))];
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+//------------------------------------------
+// results
+
+static bool first_result = true;
+static unsigned check_failures;     // results that differ from a full scan
+
+static int compare_double(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const GArray* sorted, double p)
+{
+    unsigned rank = (unsigned)ceil(p / 100.0 * sorted->len);
+    return g_array_index(sorted, double, rank ? rank - 1 : 0);
+}
+
+// samples are in microseconds, the array is sorted and emptied
+static void report(unsigned corpus_size, const char* name, const char* param, GArray* samples)
+{
+    if (samples->len == 0)
+        return;
+    qsort(samples->data, samples->len, sizeof(double), compare_double);
+    double sum = 0;
+    for (unsigned i = 0; i < samples->len; i++)
+        sum += g_array_index(samples, double, i);
+    printf("%s\n    {\"corpus\": %u, \"name\": \"%s\", \"param\": \"%s\", \"unit\": \"us\", \"samples\": %u, "
+           "\"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}",
+           first_result ? "" : ",", corpus_size, name, param ? param : "", samples->len,
+           sum / samples->len, percentile(samples, 50), percentile(samples, 90),
+           percentile(samples, 99), g_array_index(samples, double, samples->len - 1));
+    first_result = false;
+    g_array_set_size(samples, 0);
+}
+
+static void add_sample(GArray* samples, int64_t begin)
+{
+    double us = (now_ns() - begin) / 1000.0;
+    g_array_append_val(samples, us);
+}
+
+//------------------------------------------
+// corpus generation
+
+static void write_png(const char* file)
+{
+    GdkPixbuf* pb = gdk_pixbuf_new(GDK_COLORSPACE_RGB, true, 8, 128, 128);
+    gdk_pixbuf_fill(pb, rng() | 0xff);
+    gdk_pixbuf_save(pb, file, "png", NULL, NULL);
+    g_object_unref(pb);
+}
+
+static void write_xpm(const char* file)
+{
+    FILE* f = fopen(file, "w");
+    if (!f)
+        return;
+    fputs("/* XPM */\nstatic char* icon[] = {\n\"32 32 2 1\",\n\"  c None\",\n\". c #3465a4\",\n", f);
+    for (int y = 0; y < 32; y++) {
+        fputc('"', f);
+        for (int x = 0; x < 32; x++)
+            fputc((x - 16) * (x - 16) + (y - 16) * (y - 16) < 196 ? '.' : ' ', f);
+        fputs(y < 31 ? "\",\n" : "\"};\n", f);
+    }
+    fclose(f);
+}
+
+static void write_svg(const char* file)
+{
+    FILE* f = fopen(file, "w");
+    if (!f)
+        return;
+    fprintf(f, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"128\" height=\"128\">\n"
+               "<rect x=\"8\" y=\"8\" width=\"112\" height=\"112\" rx=\"16\" fill=\"#%06x\"/>\n"
+               "<circle cx=\"64\" cy=\"64\" r=\"40\" fill=\"#ffffff\" opacity=\"0.5\"/>\n</svg>\n",
+               rng() & 0xffffff);
+    fclose(f);
+}
+
+// a handful of shared icon files, launchers of the same type point to them
+static void generate_icons(const char* icon_dir, char* icons[ICON_TYPES])
+{
+    g_mkdir_with_parents(icon_dir, 0700);
+    icons[ICON_THEME] = g_strdup("applications-other");
+    icons[ICON_PNG] = g_build_filename(icon_dir, "icon.png", NULL);
+    icons[ICON_XPM] = g_build_filename(icon_dir, "icon.xpm", NULL);
+    icons[ICON_SVG] = g_build_filename(icon_dir, "icon.svg", NULL);
+    write_png(icons[ICON_PNG]);
+    write_xpm(icons[ICON_XPM]);
+    write_svg(icons[ICON_SVG]);
+}
+
+static void write_launcher(const char* file, unsigned n, char* icons[ICON_TYPES])
+{
+    FILE* f = fopen(file, "w");
+    if (!f)
+        return;
+    char name[128] = "";
+    unsigned word_count = 1 + rng() % 3;
+    for (unsigned i = 0; i < word_count; i++) {
+        const char* w = random_word();
+        if (i)
+            strcat(name, " ");
+        strncat(name, w, sizeof(name) - strlen(name) - 2);
+        if (i == 0)
+            name[0] = g_ascii_toupper(name[0]);
+    }
+    char* exec_name = g_ascii_strdown(name, -1);
+    g_strdelimit(exec_name, " ", '-');
+
+    fprintf(f, "[Desktop Entry]\nVersion=1.0\nType=Application\nName=%s %u\n", name, n);
+    if (rng() % 4 == 0)
+        fprintf(f, "Name[de]=%s %u\nName[fr]=%s %u\nGenericName[de]=Programm\n", name, n, name, n);
+    fprintf(f, "GenericName=%s\nComment=Synthetic launcher number %u for benchmarking\n", random_word(), n);
+
+    unsigned kind = rng() % 10;
+    if (kind < 6)
+        fprintf(f, "Exec=/usr/bin/%s %%U\n", exec_name);
+    else if (kind < 8)
+        fprintf(f, "Exec=%s --new-window %%u\n", exec_name);
+    else if (kind < 9)
+        fprintf(f, "Exec=env GDK_BACKEND=x11 %s -- %%F\n", exec_name);
+    else
+        fprintf(f, "Exec=\"/opt/%s/bin/%s\" --profile=\"default\" %%f\n", exec_name, exec_name);
+
+    double u = rng_unit();
+    int icon = u < 0.4 ? ICON_THEME : u < 0.7 ? ICON_PNG : u < 0.85 ? ICON_XPM : ICON_SVG;
+    fprintf(f, "Icon=%s\n", icons[icon]);
+    fprintf(f, "Terminal=%s\nCategories=Utility;%s;\nKeywords=%s;%s;\n", rng() % 20 ? "false" : "true",
+            random_word(), random_word(), random_word());
+    if (rng() % 20 == 0)
+        fputs("NoDisplay=true\n", f);
+    fputs("\n[Desktop Action new-window]\nName=New Window\nExec=true\n", f);
+    fclose(f);
+    g_free(exec_name);
+}
+
+static void generate_launchers(const char* app_dir, unsigned count, char* icons[ICON_TYPES])
+{
+    g_mkdir_with_parents(app_dir, 0700);
+    for (unsigned i = 0; i < count; i++) {
+        char* file = g_strdup_printf("%s/bench-%06u.desktop", app_dir, i);
+        write_launcher(file, i, icons);
+        g_free(file);
+    }
+}
+
+static void remove_dir(const char* dir_name)
+{
+    DIR* dir = opendir(dir_name);
+    if (!dir)
+        return;
+    struct dirent* ent = NULL;
+    while ((ent = readdir(dir))) {
+        if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
+            continue;
+        char* path = g_build_filename(dir_name, ent->d_name, NULL);
+        if (g_file_test(path, G_FILE_TEST_IS_DIR))
+            remove_dir(path);
+        else
+            g_remove(path);
+        g_free(path);
+    }
+    closedir(dir);
+    g_rmdir(dir_name);
+}
+
+//------------------------------------------
+// benchmarks
+
+// drop all launchers and the arena they live in
+static void reset_launchers(void)
+{
+    g_hash_table_remove_all(action_map);
+    free_generation(generation);
+    generation = new_generation();
+    scan_free(&launcher_tree);
+}
+
+// replaced snapshots are released from an idle callback
+static void release_snapshots(void)
+{
+    while (g_main_context_iteration(NULL, false));
+}
+
+static void reset_filter(void)
+{
+    if (filter_list->len)
+        g_array_remove_range(filter_list, 0, filter_list->len);
+    last_filter = STR_S("");
+}
+
+static void bench_scan(unsigned n, const BenchOptions* opt, GArray* samples)
+{
+    for (unsigned r = 0; r < opt->runs; r++) {
+        reset_launchers();
+        int64_t begin = now_ns();
+        scan_launchers(launcher_roots, root_count);
+        add_sample(samples, begin);
+    }
+    report(n, "scan_launchers", "cold", samples);
+
+    // nothing changed, one stat per directory and the index is rewritten
+    update_all(NULL); // settings and commands are read before timing
+    for (unsigned r = 0; r < opt->runs; r++) {
+        index_dirty = true;
+        int64_t begin = now_ns();
+        update_all(NULL);
+        add_sample(samples, begin);
+    }
+    report(n, "update_all", "warm", samples);
+
+    // startup with an up to date index, update_all above wrote it
+    for (unsigned r = 0; r < opt->runs; r++) {
+        reset_launchers();
+        index_close(&launcher_index);
+        int64_t begin = now_ns();
+        load_index(index_file);
+        add_sample(samples, begin);
+    }
+    report(n, "load_index", NULL, samples);
+    reset_launchers();
+    index_close(&launcher_index);
+    update_all(NULL);
+
+    // what the snapshot thread does after every change
+    for (unsigned r = 0; r < opt->runs; r++) {
+        int64_t begin = now_ns();
+        update_snapshot();
+        add_sample(samples, begin);
+        release_snapshots();
+    }
+    report(n, "update_snapshot", NULL, samples);
+}
+
+// the keys of the current results, best first
+static GArray* result_keys(void)
+{
+    GArray* keys = g_array_sized_new(false, false, sizeof(uint64_t), filter_keys->len);
+    g_array_append_vals(keys, filter_keys->data, filter_keys->len);
+    qsort(keys->data, keys->len, sizeof(uint64_t), compare_key);
+    return keys;
+}
+
+// typing narrows the previous results, which has to give what a full scan of each prefix gives
+// queries start anywhere in names and execs, so matches far from the start are covered too
+static void check_narrowing(GPtrArray* texts)
+{
+    for (unsigned q = 0; q < BENCH_CHECKS; q++) {
+        const char* text = g_ptr_array_index(texts, rng() % texts->len);
+        const char* start = text + rng() % strlen(text);
+        char query[BENCH_QUERY_LEN];
+        unsigned len = 0;
+        while (len < BENCH_QUERY_LEN && start[len] && start[len] != ' ') {
+            query[len] = g_ascii_tolower(start[len]);
+            len++;
+        }
+
+        GArray* typed[BENCH_QUERY_LEN];
+        reset_filter();
+        for (unsigned i = 0; i < len; i++) {
+            filter_action_list(str_wrap_n(query, i + 1));
+            typed[i] = result_keys();
+        }
+        for (unsigned i = 0; i < len; i++) {
+            reset_filter();
+            filter_action_list(str_wrap_n(query, i + 1));
+            GArray* full = result_keys();
+            if ((full->len != typed[i]->len || memcmp(full->data, typed[i]->data, full->len * sizeof(uint64_t)))
+                && check_failures++ < 10)
+                fprintf(stderr, "narrowing \"%.*s\": %u results while typing, %u from a full scan\n",
+                        (int)i + 1, query, typed[i]->len, full->len);
+            g_array_free(full, true);
+            g_array_free(typed[i], true);
+        }
+    }
+    reset_filter();
+}
+
+// type random launcher names one character at a time
+static void bench_filter(unsigned n, GArray* samples)
+{
+    GPtrArray* names = g_ptr_array_new();
+    GPtrArray* texts = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+    g_hash_table_iter_init(&iter, action_map);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        const Action* a = value;
+        if (a->name.len > 0) {
+            g_ptr_array_add(names, a->name.str);
+            g_ptr_array_add(texts, a->name.str);
+        }
+        if (a->exec.len > 0)
+            g_ptr_array_add(texts, a->exec.str);
+    }
+    if (names->len == 0) {
+        g_ptr_array_free(names, true);
+        g_ptr_array_free(texts, true);
+        return;
+    }
+
+    update_snapshot();
+    release_snapshots();
+    check_narrowing(texts);
+    g_ptr_array_free(texts, true);
+    reset_filter();
+
+    GArray* by_len[BENCH_QUERY_LEN];
+    for (int i = 0; i < BENCH_QUERY_LEN; i++)
+        by_len[i] = g_array_new(false, false, sizeof(double));
+    for (unsigned q = 0; q < BENCH_QUERIES; q++) {
+        const char* name = g_ptr_array_index(names, rng() % names->len);
+        reset_filter();
+        // only the first word is used as filter, see get_first_input_word
+        for (int len = 1; len <= BENCH_QUERY_LEN && name[len - 1] != ' '; len++) {
+            char query[INPUT_STRING_SIZE];
+            for (int i = 0; i < len; i++)
+                query[i] = g_ascii_tolower(name[i]);
+            query[len] = 0;
+            int64_t begin = now_ns();
+            filter_action_list(str_wrap_n(query, len));
+            add_sample(by_len[len - 1], begin);
+        }
+    }
+    for (int i = 0; i < BENCH_QUERY_LEN; i++) {
+        char param[16];
+        snprintf(param, sizeof(param), "len=%d", i + 1);
+        report(n, "filter_action_list", param, by_len[i]);
+        g_array_free(by_len[i], true);
+    }
+
+    // ordering everything past the top results, as when scrolling to the end
+    for (unsigned q = 0; q < BENCH_QUERIES; q++) {
+        const char* name = g_ptr_array_index(names, rng() % names->len);
+        char query[2] = {g_ascii_tolower(name[0]), 0};
+        reset_filter();
+        filter_action_list(str_wrap_n(query, 1));
+        if (filter_list->len == 0)
+            continue;
+        int64_t begin = now_ns();
+        sort_filter_list_until(filter_list->len - 1);
+        add_sample(samples, begin);
+    }
+    report(n, "sort_filter_list_until", "all", samples);
+    reset_filter();
+    g_ptr_array_free(names, true);
+}
+
+static void bench_mnemonics(unsigned n, const BenchOptions* opt, GArray* samples)
+{
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+    g_hash_table_iter_init(&iter, action_map);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        Action* a = value;
+        if (rng() % 10 || a->mnemonic.len)
+            continue;
+        char m[4] = {'a' + rng() % 26, 'a' + rng() % 26, 'a' + rng() % 26, 0};
+        a->mnemonic = str_new(m);
+        a->time = 1000000 + rng();
+    }
+    for (unsigned r = 0; r < opt->runs; r++) {
+        int64_t begin = now_ns();
+        save_mnemonics(mnemonic_file, action_map);
+        add_sample(samples, begin);
+    }
+    report(n, "save_mnemonics", NULL, samples);
+    for (unsigned r = 0; r < opt->runs; r++) {
+        int64_t begin = now_ns();
+        load_mnemonics(mnemonic_file, action_map); // the old strings leak, as they would in fehlstart
+        add_sample(samples, begin);
+    }
+    report(n, "load_mnemonics", NULL, samples);
+
+    // what a launch costs instead of save_mnemonics, then replaying those launches at startup
+    open_journal(journal_file);
+    g_hash_table_iter_init(&iter, action_map);
+    for (unsigned i = 0; i < JOURNAL_COMPACT_SIZE && g_hash_table_iter_next(&iter, &key, &value); i++) {
+        Action* a = value;
+        int64_t begin = now_ns();
+        journal_append(&usage_journal, journal_hash(a->key), a->mnemonic, a->time);
+        add_sample(samples, begin);
+    }
+    report(n, "journal_append", NULL, samples);
+    for (unsigned r = 0; r < opt->runs; r++) {
+        journal_close(&usage_journal);
+        int64_t begin = now_ns();
+        open_journal(journal_file);
+        add_sample(samples, begin);
+    }
+    report(n, "open_journal", NULL, samples);
+    journal_close(&usage_journal);
+    g_remove(journal_file);
+}
+
+// the real $PATH, independent of the corpus
+static void bench_path(const BenchOptions* opt, GArray* samples)
+{
+    const char* path = getenv("PATH");
+    PathCache cache = {0};
+    for (unsigned r = 0; r < opt->runs; r++) {
+        path_free(&cache);
+        int64_t begin = now_ns();
+        path_update(&cache, path);
+        add_sample(samples, begin);
+    }
+    report(0, "path_update", "cold", samples);
+
+    // nothing changed, one stat per directory
+    for (unsigned r = 0; r < opt->runs; r++) {
+        int64_t begin = now_ns();
+        path_update(&cache, path);
+        add_sample(samples, begin);
+    }
+    report(0, "path_update", "warm", samples);
+    fprintf(stderr, "path: %u executables\n", cache.count);
+    path_free(&cache);
+}
+
+static void bench_icons(unsigned n, char* icons[ICON_TYPES], bool have_display, GArray* samples)
+{
+    for (int t = 0; t < ICON_TYPES; t++) {
+        if (t == ICON_THEME && !have_display)
+            continue; // the default icon theme needs a screen
+        for (int i = 0; i < BENCH_ICONS; i++) {
+            int64_t begin = now_ns();
+            GdkPixbuf* pb = load_icon(icons[t], BENCH_ICON_SIZE);
+            add_sample(samples, begin);
+            if (pb)
+                g_object_unref(pb);
+        }
+        report(n, "load_icon", icon_type_names[t], samples);
+    }
+}
+
+//------------------------------------------
+// main
+
+static void parse_options(int argc, char** argv, BenchOptions* opt)
+{
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--sizes") && i + 1 < argc) {
+            opt->size_count = 0;
+            char** list = g_strsplit(argv[++i], ",", -1);
+            for (int j = 0; list[j] && opt->size_count < BENCH_MAX_SIZES; j++)
+                if (atoi(list[j]) > 0)
+                    opt->sizes[opt->size_count++] = atoi(list[j]);
+            g_strfreev(list);
+        } else if (!strcmp(argv[i], "--runs") && i + 1 < argc) {
+            opt->runs = atoi(argv[++i]) > 0 ? atoi(argv[i]) : 1;
+        } else if (!strcmp(argv[i], "--fuzzy")) {
+            opt->fuzzy = true;
+        } else if (!strcmp(argv[i], "--keep")) {
+            opt->keep = true;
+        } else {
+            printf("usage: fehlstart-bench [--sizes 100,1000,...] [--runs n] [--fuzzy] [--keep]\n");
+            exit(strcmp(argv[i], "--help") ? EXIT_FAILURE : EXIT_SUCCESS);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions opt = {{100, 1000, 10000}, 3, 5, false, false};
+    bool have_display = gtk_init_check(&argc, &argv);
+    parse_options(argc, argv, &opt);
+    settings.Matching_fuzzy = opt.fuzzy;
+    settings.Path_search = false; // keep the corpus synthetic
+
+    char base[] = "/tmp/fehlstart-bench-XXXXXX";
+    if (!mkdtemp(base)) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    setting_file = g_build_filename(base, SETTINGS_FILE_NAME, NULL);
+    mnemonic_file = g_build_filename(base, MNEMONICS_FILE_NAME, NULL);
+    journal_file = g_build_filename(base, JOURNAL_FILE_NAME, NULL);
+    commands_file = g_build_filename(base, COMMANDS_FILE_NAME, NULL);
+    index_file = g_build_filename(base, INDEX_FILE_NAME, NULL);
+    action_map = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, free_action);
+    generation = new_generation();
+    filter_list = g_array_sized_new(false, true, sizeof(uint32_t), 250);
+    filter_keys = g_array_sized_new(false, false, sizeof(uint64_t), 250);
+    desktop_init("GNOME", g_get_language_names(), NULL);
+
+    char* icon_dir = g_build_filename(base, "icons", NULL);
+    char* icons[ICON_TYPES];
+    generate_icons(icon_dir, icons);
+    GArray* samples = g_array_new(false, false, sizeof(double));
+
+    printf("{\"benchmark\": \"fehlstart\", \"runs\": %u, \"fuzzy\": %s, \"display\": %s, \"results\": [",
+           opt.runs, opt.fuzzy ? "true" : "false", have_display ? "true" : "false");
+    for (unsigned s = 0; s < opt.size_count; s++) {
+        unsigned n = opt.sizes[s];
+        user_app_dir = g_strdup_printf("%s/applications-%u", base, n);
+        launcher_roots[0] = user_app_dir; // the system dirs would add the host's launchers
+        root_count = 1;
+        fprintf(stderr, "corpus %u: generating\n", n);
+        generate_launchers(user_app_dir, n, icons);
+        fprintf(stderr, "corpus %u: scanning\n", n);
+        bench_scan(n, &opt, samples);
+        fprintf(stderr, "corpus %u: filtering\n", n);
+        bench_filter(n, samples);
+        bench_mnemonics(n, &opt, samples);
+        bench_icons(n, icons, have_display, samples);
+
+        reset_launchers();
+        if (!opt.keep)
+            remove_dir(user_app_dir);
+        g_free(user_app_dir);
+        user_app_dir = NULL;
+    }
+    bench_path(&opt, samples);
+    printf("\n]}\n");
+
+    if (!opt.keep)
+        remove_dir(base);
+    else
+        fprintf(stderr, "generated files kept in %s\n", base);
+    g_array_free(samples, true);
+    if (check_failures)
+        fprintf(stderr, "%u filter results differed from a full scan\n", check_failures);
+    return check_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
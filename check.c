@@ -0,0 +1,173 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+// differential test, run with "make check"
+// compares the substring search kernels of str.c against a naive search
+// mismatches are printed to stderr, the exit code tells if there were any
+
+#include "str.c"
+
+#include <stdio.h>
+
+#define CHECK_ROUNDS        200000
+#define CHECK_MAX_LEN       100     // haystacks cover several 16 and 32 byte blocks
+#define CHECK_MAX_NEEDLE    8
+
+typedef uint32_t (*FindFunc)(String, String, uint32_t, bool);
+
+typedef struct {
+    const char* name;
+    FindFunc    find;
+    unsigned    failures;
+} Kernel;
+
+static Kernel kernels[] = {
+    {"scalar", find_scalar, 0},
+#ifdef STR_SIMD
+    {"sse2", find_sse2, 0},
+    {"avx2", find_avx2, 0},
+#endif
+};
+static unsigned kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static char naive_fold(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// the reference, first position at or after begin
+static uint32_t find_naive(String s, String what, uint32_t begin, bool fold_case)
+{
+    for (uint32_t i = begin; i + what.len <= s.len; i++) {
+        uint32_t j = 0;
+        while (j < what.len && (fold_case ? naive_fold(s.str[i + j]) == naive_fold(what.str[j])
+                                          : s.str[i + j] == what.str[j]))
+            j++;
+        if (j == what.len)
+            return i;
+    }
+    return STR_END;
+}
+
+// kernels the cpu can't run are left out
+static void select_kernels(void)
+{
+#ifdef STR_SIMD
+    __builtin_cpu_init();
+    unsigned n = 0;
+    for (unsigned k = 0; k < kernel_count; k++) {
+        if ((!strcmp(kernels[k].name, "sse2") && !__builtin_cpu_supports("sse2"))
+            || (!strcmp(kernels[k].name, "avx2") && !__builtin_cpu_supports("avx2"))) {
+            fprintf(stderr, "%s: not supported by this cpu, skipped\n", kernels[k].name);
+            continue;
+        }
+        kernels[n++] = kernels[k];
+    }
+    kernel_count = n;
+#endif
+}
+
+// haystack and needle are copied into buffers of their exact size, so
+// sanitizers see reads past the end
+static void check_case(const char* s, uint32_t s_len, const char* what, uint32_t what_len, uint32_t begin)
+{
+    char* hay = malloc(s_len ? s_len : 1);
+    char* needle = malloc(what_len);
+    memcpy(hay, s, s_len);
+    memcpy(needle, what, what_len);
+    String hs = {hay, s_len, false};
+    String ns = {needle, what_len, false};
+    for (int fold_case = 0; fold_case < 2; fold_case++) {
+        uint32_t expected = find_naive(hs, ns, begin, fold_case);
+        for (unsigned k = 0; k < kernel_count; k++) {
+            uint32_t got = kernels[k].find(hs, ns, begin, fold_case);
+            if (got == expected)
+                continue;
+            if (kernels[k].failures++ < 10)
+                fprintf(stderr, "%s: \"%.*s\" in \"%.*s\" from %u%s: got %d, expected %d\n", kernels[k].name,
+                        (int)what_len, what, (int)s_len, s, begin, fold_case ? " folded" : "",
+                        (int)got, (int)expected);
+        }
+    }
+    free(hay);
+    free(needle);
+}
+
+static void check_fixed(void)
+{
+    static const char* cases[][2] = {
+        {"aaab", "aab"},                // overlapping candidates
+        {"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab", "aab"},
+        {"abababababababababababababababababababac", "abac"},
+        {"Firefox Web Browser", "BROWSER"},
+        {"firefox", "x"},
+        {"x", "x"},
+        {"0123456789abcdef0123456789ABCDEF0123456789abcdefXY", "XY"}, // across block ends
+        {"0123456789abcdefX", "fX"},
+        {"\xc3\xa4pfel \xc3\x84PFEL", "\xc3\x84pfel"}, // bytes above 0x7f are not folded
+        {"[\\]^_`@AZaz{", "@az"},    // neighbours of the letter ranges
+        {"no match here", "absent"},
+    };
+    for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint32_t s_len = strlen(cases[i][0]), what_len = strlen(cases[i][1]);
+        for (uint32_t begin = 0; begin <= s_len; begin++)
+            check_case(cases[i][0], s_len, cases[i][1], what_len, begin);
+    }
+}
+
+// small alphabets make partial matches and overlaps common
+static void check_random(void)
+{
+    static const char alphabet[] = "aAbBzZ-@[`{\xc3";
+    char s[CHECK_MAX_LEN], what[CHECK_MAX_NEEDLE];
+    for (unsigned r = 0; r < CHECK_ROUNDS; r++) {
+        uint32_t letters = 2 + rng() % (sizeof(alphabet) - 2);
+        uint32_t s_len = rng() % (CHECK_MAX_LEN + 1);
+        uint32_t what_len = 1 + rng() % CHECK_MAX_NEEDLE;
+        for (uint32_t i = 0; i < s_len; i++)
+            s[i] = alphabet[rng() % letters];
+        if (s_len >= what_len && rng() % 2) { // plant a hit, maybe in another case
+            uint32_t at = rng() % (s_len - what_len + 1);
+            for (uint32_t i = 0; i < what_len; i++)
+                what[i] = rng() % 4 ? s[at + i] : naive_fold(s[at + i]);
+        } else {
+            for (uint32_t i = 0; i < what_len; i++)
+                what[i] = alphabet[rng() % letters];
+        }
+        uint32_t begin = rng() % 4 ? 0 : rng() % (s_len + 1);
+        check_case(s, s_len, what, what_len, begin);
+    }
+}
+
+int main(void)
+{
+    select_kernels();
+    check_fixed();
+    check_random();
+    unsigned failures = 0;
+    for (unsigned k = 0; k < kernel_count; k++) {
+        printf("%s: %s\n", kernels[k].name, kernels[k].failures ? "FAILED" : "ok");
+        failures += kernels[k].failures;
+    }
+    // the public functions, through the dispatcher
+    if (str_find_first(STR_S("aaab"), STR_S("aab")) != 1 || str_find_first_i(STR_S("xAAB"), STR_S("aab")) != 1
+        || str_find_first(STR_S("ab"), STR_S("abc")) != STR_END || str_find_first(STR_S("ab"), STR_S("")) != STR_END) {
+        printf("str_find_first: FAILED\n");
+        failures++;
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,48 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+// fehlstart-client, tells a running fehlstart to show its window
+// meant for window manager key bindings, it doesn't link gtk so it starts fast
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "ipc.h"
+
+static void usage(void)
+{
+    printf("usage: fehlstart-client [--show | --toggle | --query]\n"
+           "\t--show\t\tshow the launcher window (default)\n"
+           "\t--toggle\tshow or hide the launcher window\n"
+           "\t--query\t\tprint the state of the running instance\n");
+}
+
+int main(int argc, char** argv)
+{
+    const char* command = IPC_SHOW;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--show")) {
+            command = IPC_SHOW;
+        } else if (!strcmp(argv[i], "--toggle")) {
+            command = IPC_TOGGLE;
+        } else if (!strcmp(argv[i], "--query")) {
+            command = IPC_QUERY;
+        } else {
+            usage();
+            return strcmp(argv[i], "--help") ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+    }
+
+    char path[IPC_PATH_SIZE], reply[IPC_MAX_MESSAGE];
+    if (!ipc_socket_path(path, sizeof(path)) || !ipc_request(path, command, reply, sizeof(reply))) {
+        fprintf(stderr, "fehlstart is not running\n");
+        return EXIT_FAILURE;
+    }
+    if (!strcmp(command, IPC_QUERY))
+        printf("%s\n", reply);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include "corpus.h"
+
+void corpus_clear(Corpus* c)
+{
+    c->text_len = 0;
+    c->count = 0;
+}
+
+void corpus_free(Corpus* c)
+{
+    free(c->text);
+    for (int f = 0; f < CORPUS_FIELD_COUNT; f++) {
+        free(c->offset[f]);
+        free(c->length[f]);
+    }
+    free(c->items);
+    memset(c, 0, sizeof(Corpus));
+}
+
+static void reserve_items(Corpus* c)
+{
+    if (c->count < c->cap)
+        return;
+    c->cap = c->cap ? c->cap * 2 : 256;
+    for (int f = 0; f < CORPUS_FIELD_COUNT; f++) {
+        c->offset[f] = realloc(c->offset[f], c->cap * sizeof(uint32_t));
+        c->length[f] = realloc(c->length[f], c->cap * sizeof(uint32_t));
+    }
+    c->items = realloc(c->items, c->cap * sizeof(void*));
+}
+
+static void reserve_text(Corpus* c, uint32_t len)
+{
+    if (c->text_len + len <= c->text_cap)
+        return;
+    while (c->text_len + len > c->text_cap)
+        c->text_cap = c->text_cap ? c->text_cap * 2 : 16384;
+    c->text = realloc(c->text, c->text_cap);
+}
+
+static void add_field(Corpus* c, CorpusField f, String s, bool fold)
+{
+    reserve_text(c, s.len + 1);
+    char* dst = c->text + c->text_len;
+    if (fold)
+        for (uint32_t i = 0; i < s.len; i++)
+            dst[i] = tolower((unsigned char)s.str[i]);
+    else
+        memcpy(dst, s.str, s.len);
+    dst[s.len] = 0;
+    c->offset[f][c->count] = c->text_len;
+    c->length[f][c->count] = s.len;
+    c->text_len += s.len + 1;
+}
+
+uint32_t corpus_add(Corpus* c, String name, String exec, String mnemonic, void* item)
+{
+    reserve_items(c);
+    add_field(c, CORPUS_NAME, name, true);
+    add_field(c, CORPUS_EXEC, exec, true);
+    add_field(c, CORPUS_MNEMONIC, mnemonic, false);
+    c->items[c->count] = item;
+    return c->count++;
+}
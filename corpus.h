@@ -0,0 +1,54 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include "str.h"
+
+// search corpus: the searchable strings of all items in one contiguous
+// block with offsets and lengths in parallel arrays, so a filter pass is
+// a linear sweep that never touches the items themselves
+
+typedef enum {
+    CORPUS_NAME,                    // lowercase
+    CORPUS_EXEC,                    // lowercase
+    CORPUS_MNEMONIC,                // as typed, mnemonics are case sensitive
+    CORPUS_FIELD_COUNT
+} CorpusField;
+
+typedef struct {
+    char*       text;               // all strings, zero separated
+    uint32_t    text_len;
+    uint32_t    text_cap;
+    uint32_t*   offset[CORPUS_FIELD_COUNT];
+    uint32_t*   length[CORPUS_FIELD_COUNT];
+    void**      items;
+    uint32_t    count;
+    uint32_t    cap;
+} Corpus;
+
+// remove all entries, memory is kept for the next build
+void corpus_clear(Corpus* c);
+
+// release all memory
+void corpus_free(Corpus* c);
+
+// append an item, returns its index
+uint32_t corpus_add(Corpus* c, String name, String exec, String mnemonic, void* item);
+
+static inline String corpus_get(const Corpus* c, uint32_t i, CorpusField f)
+{
+    return (String) {c->text + c->offset[f][i], c->length[f][i], false};
+}
+
+static inline void* corpus_item(const Corpus* c, uint32_t i)
+{
+    return c->items[i];
+}
+
+#endif
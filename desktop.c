@@ -0,0 +1,369 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "desktop.h"
+
+// see http://standards.freedesktop.org/desktop-entry-spec/latest/
+
+#define RANK_NONE           UINT32_MAX
+#define RANK_DEFAULT        (UINT32_MAX - 1)    // Name without locale
+
+static const char*          desktop_env = "";
+static const char* const*   languages;
+static const char*          terminal = DESKTOP_TERMINAL;
+
+// programs that run something else, a launcher of theirs doesn't stand for them
+static const char* const    wrappers[] = {
+    "env", "sh", "bash", "dash", "zsh", "flatpak", "snap", "java", "python", "python2", "python3",
+    "perl", "ruby", "node", "wine", "mono", "sudo", "pkexec", "xdg-open", NULL
+};
+
+typedef struct {
+    char**      argv;
+    uint32_t    argc;
+    char*       arg;                // argument under construction
+    uint32_t    arg_len;
+    uint32_t    arg_cap;
+    bool        in_arg;             // true if arg was started, "" is a valid argument
+} ArgList;
+
+void desktop_init(const char* env, const char* const* langs, const char* term)
+{
+    desktop_env = env ? env : "";
+    languages = langs;
+    terminal = term ? term : DESKTOP_TERMINAL;
+}
+
+//------------------------------------------
+// parser
+
+inline static bool is_space(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static uint32_t language_rank(String locale)
+{
+    for (uint32_t i = 0; languages && languages[i]; i++)
+        if (str_equal(locale, str_wrap(languages[i])))
+            return i;
+    return RANK_NONE;
+}
+
+// replaces \s \n \t \r \\ in place
+static String unescape(char* s, uint32_t len)
+{
+    if (!memchr(s, '\\', len))
+        return str_wrap_n(s, len);
+    char* w = s;
+    for (uint32_t r = 0; r < len; r++) {
+        if (s[r] != '\\' || r + 1 == len) {
+            *w++ = s[r];
+            continue;
+        }
+        switch (s[++r]) {
+        case 's': *w++ = ' '; break;
+        case 'n': *w++ = '\n'; break;
+        case 't': *w++ = '\t'; break;
+        case 'r': *w++ = '\r'; break;
+        case '\\': *w++ = '\\'; break;
+        default: *w++ = '\\'; *w++ = s[r]; break; // keep others, e.g. \" for Exec
+        }
+    }
+    *w = 0;
+    return str_wrap_n(s, w - s);
+}
+
+// list is a ; separated string list
+static bool list_contains(String list, String item)
+{
+    uint32_t begin = 0;
+    for (uint32_t i = 0; i <= list.len; i++) {
+        if (i < list.len && list.str[i] != ';')
+            continue;
+        if (i > begin && str_equal(str_substring(list, begin, i - begin), item))
+            return true;
+        begin = i + 1;
+    }
+    return false;
+}
+
+static bool is_true(String value)
+{
+    return str_equal(value, STR_S("true"));
+}
+
+static void parse_key(DesktopEntry* e, String key, String locale, String value, uint32_t* name_rank, bool* type_ok)
+{
+    if (str_equal(key, STR_S("Name"))) {
+        uint32_t rank = locale.len ? language_rank(locale) : RANK_DEFAULT;
+        if (rank < *name_rank) {
+            *name_rank = rank;
+            e->name = value;
+        }
+    }
+    if (locale.len)
+        return;
+
+    String env = str_wrap(desktop_env);
+    if (str_equal(key, STR_S("Exec")))
+        e->exec = value;
+    else if (str_equal(key, STR_S("Icon")))
+        e->icon = value;
+    else if (str_equal(key, STR_S("TryExec")))
+        e->try_exec = value;
+    else if (str_equal(key, STR_S("Path")))
+        e->path = value;
+    else if (str_equal(key, STR_S("Terminal")))
+        e->terminal = is_true(value);
+    else if (str_equal(key, STR_S("Type")))
+        *type_ok = str_equal(value, STR_S("Application"));
+    else if (str_equal(key, STR_S("Hidden")) || str_equal(key, STR_S("NoDisplay")))
+        e->hidden |= is_true(value);
+    else if (str_equal(key, STR_S("OnlyShowIn")))
+        e->hidden |= !list_contains(value, env);
+    else if (str_equal(key, STR_S("NotShowIn")))
+        e->hidden |= list_contains(value, env);
+}
+
+bool desktop_parse(char* data, uint32_t len, DesktopEntry* e)
+{
+    *e = (DesktopEntry) {STR_I(""), STR_I(""), STR_I(""), STR_I(""), STR_I(""), false, false};
+    data[len] = 0;
+
+    uint32_t name_rank = RANK_NONE;
+    bool in_group = false, found = false, type_ok = false;
+    char* end = data + len;
+    for (char* p = data; p < end;) {
+        char* line = p;
+        char* eol = memchr(p, '\n', end - p);
+        eol = eol ? eol : end;
+        p = eol + 1;
+        *eol = 0;
+        while (eol > line && (is_space(eol[-1]) || eol[-1] == '\r'))
+            *--eol = 0;
+        while (is_space(*line))
+            line++;
+
+        if (*line == '#' || *line == 0)
+            continue;
+        if (*line == '[') {
+            if (in_group)
+                break; // only the first [Desktop Entry] group is of interest
+            in_group = !strcmp(line, "[Desktop Entry]");
+            found |= in_group;
+            continue;
+        }
+        char* eq = in_group ? strchr(line, '=') : NULL;
+        if (!eq)
+            continue;
+
+        char* key_end = eq;
+        while (key_end > line && is_space(key_end[-1]))
+            key_end--;
+        char* value = eq + 1;
+        while (is_space(*value))
+            value++;
+
+        String key = str_wrap_n(line, key_end - line);
+        String locale = STR_S("");
+        uint32_t bracket = str_find_first(key, STR_S("["));
+        if (bracket != STR_END && str_ends_with(key, STR_S("]"))) {
+            locale = str_substring(key, bracket + 1, key.len - bracket - 2);
+            key = str_substring(key, 0, bracket);
+        }
+        parse_key(e, key, locale, unescape(value, eol - value), &name_rank, &type_ok);
+    }
+    e->hidden |= !type_ok;
+    return found;
+}
+
+bool desktop_load(const char* file_name, String* buffer, DesktopEntry* entry)
+{
+    *buffer = STR_S("");
+    FILE* f = fopen(file_name, "rb");
+    if (!f)
+        return false;
+    long size = -1;
+    if (!fseek(f, 0, SEEK_END))
+        size = ftell(f);
+    rewind(f);
+    if (size < 0) {
+        fclose(f);
+        return false;
+    }
+    *buffer = str_create(size);
+    buffer->len = fread(buffer->str, 1, size, f);
+    fclose(f);
+    return desktop_parse(buffer->str, buffer->len, entry);
+}
+
+//------------------------------------------
+// exec
+
+String desktop_executable(String exec)
+{
+    if (!str_starts_with(exec, STR_S("\""))) {
+        uint32_t end = 0;
+        while (end < exec.len && !is_space(exec.str[end]))
+            end++;
+        return str_duplicate(str_substring(exec, 0, end));
+    }
+    String dst = str_create(exec.len);
+    dst.len = 0;
+    for (uint32_t i = 1; i < exec.len && exec.str[i] != '"'; i++) {
+        if (exec.str[i] == '\\' && i + 1 < exec.len)
+            i++;
+        dst.str[dst.len++] = exec.str[i];
+    }
+    return dst;
+}
+
+String desktop_icon(String icon)
+{
+    if (str_starts_with(icon, STR_S("/")))
+        return icon;
+    if (str_ends_with(icon, STR_S(".png")) || str_ends_with(icon, STR_S(".xpm"))
+        || str_ends_with(icon, STR_S(".svg")))
+        return str_substring(icon, 0, icon.len - 4);
+    return icon;
+}
+
+static void arg_append(ArgList* a, String s)
+{
+    if (a->arg_len + s.len + 1 > a->arg_cap) {
+        a->arg_cap = (a->arg_len + s.len + 1) * 2;
+        a->arg = realloc(a->arg, a->arg_cap);
+    }
+    memcpy(a->arg + a->arg_len, s.str, s.len);
+    a->arg_len += s.len;
+    a->in_arg = true;
+}
+
+static void arg_end(ArgList* a)
+{
+    if (!a->in_arg)
+        return;
+    char* arg = malloc(a->arg_len + 1);
+    memcpy(arg, a->arg, a->arg_len);
+    arg[a->arg_len] = 0;
+    a->argv[a->argc++] = arg;
+    a->arg_len = 0;
+    a->in_arg = false;
+}
+
+static void arg_add(ArgList* a, String s)
+{
+    arg_end(a);
+    arg_append(a, s);
+    arg_end(a);
+}
+
+// split exec into arguments, field codes are only expanded if e is given
+static void split_exec(ArgList* a, String exec, const DesktopEntry* e, const char* file_name)
+{
+    const char* nul = memchr(exec.str, 0, exec.len);
+    if (nul)
+        exec.len = nul - exec.str; // the rest isn't part of the string
+    bool quoted = false;
+    for (uint32_t i = 0; i < exec.len; i++) {
+        char c = exec.str[i];
+        if (!quoted && is_space(c)) {
+            arg_end(a);
+        } else if (c == '"') {
+            quoted = !quoted;
+            arg_append(a, STR_S(""));
+        } else if (quoted && c == '\\' && i + 1 < exec.len && strchr("\"`$\\", exec.str[i + 1])) {
+            arg_append(a, str_wrap_n(exec.str + ++i, 1));
+        } else if (e && c == '%' && i + 1 < exec.len) {
+            switch (exec.str[++i]) {
+            case '%':
+                arg_append(a, STR_S("%"));
+                break;
+            case 'i':
+                if (e->icon.len && !a->in_arg) {
+                    arg_add(a, STR_S("--icon"));
+                    arg_add(a, desktop_icon(e->icon));
+                } else if (e->icon.len) {
+                    arg_append(a, desktop_icon(e->icon));
+                }
+                break;
+            case 'c':
+                arg_append(a, e->name);
+                break;
+            case 'k':
+                arg_append(a, str_wrap(file_name));
+                break;
+            default:
+                break; // no files or urls are passed, deprecated codes are removed
+            }
+        } else {
+            arg_append(a, str_wrap_n(exec.str + i, 1));
+        }
+    }
+    arg_end(a);
+    free(a->arg);
+    a->arg = NULL;
+}
+
+char** desktop_exec_argv(const DesktopEntry* e, const char* file_name)
+{
+    String exec = e->exec;
+    if (exec.len == 0)
+        return NULL;
+    // every argument takes at least one character, %i takes two and results in two
+    ArgList a = {calloc(exec.len + 3, sizeof(char*)), 0, NULL, 0, 0, false};
+    if (e->terminal) {
+        arg_add(&a, str_wrap(terminal));
+        arg_add(&a, STR_S(DESKTOP_TERMINAL_EXEC_FLAG));
+    }
+    split_exec(&a, exec, e, file_name);
+    if (a.argc == (e->terminal ? 2u : 0u)) {
+        desktop_free_argv(a.argv);
+        return NULL;
+    }
+    return a.argv;
+}
+
+char** desktop_split(String command)
+{
+    if (command.len == 0)
+        return NULL;
+    ArgList a = {calloc(command.len + 1, sizeof(char*)), 0, NULL, 0, 0, false};
+    split_exec(&a, command, NULL, NULL);
+    if (a.argc == 0) {
+        desktop_free_argv(a.argv);
+        return NULL;
+    }
+    return a.argv;
+}
+
+bool desktop_runs_program(String exec)
+{
+    char** argv = desktop_split(exec);
+    if (!argv)
+        return false;
+    const char* program = strrchr(argv[0], '/');
+    program = program ? program + 1 : argv[0];
+    bool runs = true;
+    for (const char* const* w = wrappers; *w && runs; w++)
+        runs = strcmp(program, *w) != 0;
+    for (char** arg = argv + 1; *arg && runs; arg++)
+        runs = (*arg)[0] == '%' && (*arg)[1] != 0 && (*arg)[1] != '%' && (*arg)[2] == 0;
+    desktop_free_argv(argv);
+    return runs;
+}
+
+void desktop_free_argv(char** argv)
+{
+    for (char** arg = argv; arg && *arg; arg++)
+        free(*arg);
+    free(argv);
+}
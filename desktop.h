@@ -0,0 +1,65 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#ifndef DESKTOP_H
+#define DESKTOP_H
+
+#include "str.h"
+
+// prepended to Exec for Terminal=true unless desktop_init() is given another one
+#define DESKTOP_TERMINAL            "xterm"
+#define DESKTOP_TERMINAL_EXEC_FLAG  "-e"
+
+// the fields fehlstart cares about from the [Desktop Entry] group
+// all strings point into the parsed buffer and are zero terminated
+typedef struct {
+    String      name;               // best match for the configured languages
+    String      exec;
+    String      icon;
+    String      try_exec;
+    String      path;               // working directory
+    bool        terminal;
+    bool        hidden;             // Hidden, NoDisplay, Type, OnlyShowIn or NotShowIn say so
+} DesktopEntry;
+
+// set the desktop environment used for OnlyShowIn / NotShowIn, the preferred
+// languages for Name[...], most preferred first, and the terminal emulator
+// strings must stay valid, not thread safe, call before parsing
+void desktop_init(const char* desktop_env, const char* const* languages, const char* terminal);
+
+// parse data in place, data[len] must be writable and will be set to 0
+// returns false if there is no [Desktop Entry] group
+bool desktop_parse(char* data, uint32_t len, DesktopEntry* entry);
+
+// read file_name into buffer and parse it
+// buffer must be freed with str_free(), even when parsing failed
+bool desktop_load(const char* file_name, String* buffer, DesktopEntry* entry);
+
+// the executable of an Exec value, the first argument with quoting removed
+// must be freed with str_free()
+String desktop_executable(String exec);
+
+// the icon as expected by the icon theme, file extensions are removed from names
+// shares memory with icon
+String desktop_icon(String icon);
+
+// expand field codes and split Exec into an argument vector
+// file_name is used for %k, Terminal=true prepends a terminal emulator
+// returns NULL if Exec is empty, free result with desktop_free_argv()
+char** desktop_exec_argv(const DesktopEntry* entry, const char* file_name);
+
+// split a command line with the quoting rules of Exec, field codes are kept as they are
+// returns NULL if there are no arguments, free result with desktop_free_argv()
+char** desktop_split(String command);
+
+// whether Exec starts its executable with nothing but field codes, so the launcher
+// stands for that program, false for wrappers like env, sh or flatpak
+bool desktop_runs_program(String exec);
+
+void desktop_free_argv(char** argv);
+
+#endif
@@ -8,27 +8,52 @@
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
+#include <limits.h>
 #include <time.h>
 
 #include <strings.h>
-#include <dirent.h>
 #include <signal.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/inotify.h>
+#include <errno.h>
+#include <fcntl.h>
 
 #include <gtk/gtk.h>
 #include <gdk/gdkkeysyms.h>
 #include <glib/gstdio.h>
-#include <gio/gdesktopappinfo.h>
+#if GLIB_CHECK_VERSION(2,30,0)
+#include <glib-unix.h>
+#endif
 
 #include <keybinder.h>
 
 #include "str.h"
+#include "index.h"
+#include "desktop.h"
+#include "corpus.h"
+#include "match.h"
+#include "ipc.h"
+#include "latency.h"
+#include "arena.h"
+#include "spawner.h"
+#include "journal.h"
+#include "trie.h"
+#include "trigram.h"
+#include "path.h"
+#include "scan.h"
 
 // types
 
+// Exec of a commands.rc entry, split once when the file is read
+typedef struct {
+    char**      argv;
+    int         args;               // index of the COMMAND_ARGS argument, -1 appends the arguments
+    bool        shell;              // Shell=true, Exec is run by /bin/sh as it is
+} Command;
+
 typedef struct Action {
     String      key;                // map key, .desktop file
     time_t      file_time;          // .desktop time stamp
@@ -36,12 +61,96 @@ typedef struct Action {
     String      exec;               // executable / hint
     String      mnemonic;           // what user typed
     String      icon;
-    int         score;              // calculated prority
     time_t      time;               // last used timestamp
+    unsigned    launches;           // how often it was launched with a mnemonic
     void        (*action)(String, struct Action*);
+    Command*    command;            // command actions only
     bool        used;               // unused actions are cached to speed scans
+    bool        program;            // launcher that stands for exec, hides the binary of that name
 } Action;
 
+// latest journal record of an action, keyed by key_hash
+typedef struct {
+    uint64_t    key_hash;
+    char        mnemonic[JOURNAL_MNEMONIC_SIZE + 1];
+    time_t      time;
+    unsigned    count;              // records of the action in the journal
+} Usage;
+
+// what is known about a binary before PATH was read, keyed by key_hash
+typedef struct {
+    uint64_t    key_hash;
+    String      key;                // empty if only the journal knows it
+    String      mnemonic;
+    time_t      time;
+    unsigned    launches;
+} Unclaimed;
+
+// what the gui needs of an action, copied so the snapshot doesn't depend on action_map
+typedef struct {
+    String      key;                // to find the action again when it is launched
+    String      name;
+    String      icon;
+    time_t      time;
+    unsigned    launches;
+} SnapshotItem;
+
+// immutable search index of the used actions, built by the snapshot thread
+// and read by the gui without locking, see publish_snapshot()
+typedef struct {
+    Corpus      corpus;             // items are SnapshotItem*
+    Trie        mnemonics;          // corpus ids by mnemonic
+    TrigramIndex trigrams;          // corpus ids by trigrams of name and exec
+    Arena       arena;              // items, their strings and the trie
+    unsigned    refs;               // only changed on the gui thread
+} Snapshot;
+
+typedef struct {
+    GArray*     files;              // String, .desktop files to parse
+    unsigned    next;               // first file not claimed by a worker
+    pthread_mutex_t mutex;
+} ScanJob;
+
+typedef struct {
+    GArray*     files;              // new launchers, parsed in parallel after the scan
+    GHashTable* seen;               // launchers the first scan found, the others get a stat
+    GPtrArray*  dirs;               // to be watched
+} LauncherScan;
+
+// launcher records and their strings, replaced as a whole by compact_launchers
+typedef struct {
+    Arena       arena;
+    size_t      garbage;            // bytes no longer referenced, reclaimed by the next generation
+} Generation;
+
+typedef struct {
+    char*       key;                // "size:name"
+    GdkPixbuf*  pixbuf;             // NULL if the icon doesn't exist
+    GList       link;               // position in the lru list, data points to the entry
+} IconEntry;
+
+typedef struct {
+    GHashTable* map;                // key -> IconEntry
+    GQueue      lru;                // most recently used first
+    int         size;               // pixel size of the cached icons
+    unsigned    hits;
+    unsigned    misses;
+} IconCache;
+
+typedef struct {
+    char*       key;                // icon cache key
+    char*       file;
+    int         width;              // -1 keeps the aspect ratio of files
+    int         height;
+    unsigned    generation;         // outdated jobs are dropped
+    GdkPixbuf*  pixbuf;
+} IconJob;
+
+typedef struct {
+    int         wd;                 // inotify watch descriptor
+    String      dir;
+} Watch;
+
 typedef struct {
     double      r;
     double      g;
@@ -49,6 +158,28 @@ typedef struct {
     double      a;
 } Color;
 
+typedef struct {
+    cairo_surface_t* surface;       // background, arch and border
+    Color       window;
+    Color       border;
+    Color       label;              // labels and dots
+    bool        valid;              // cleared when settings, style or screen change
+} Chrome;
+
+typedef struct {
+    char*       text;               // NULL if the slot is empty
+    int         size;               // requested font size
+    int         max_width;
+    int         fit_size;           // largest size not wider than max_width, at least 7
+    double      width;              // text width at fit_size
+} TextFit;
+
+// timed parts of a keystroke, see write_latency
+enum {
+    STAGE_KEY, STAGE_LOCK, STAGE_INPUT, STAGE_FILTER, STAGE_SORT, STAGE_SHOW, STAGE_ICON, STAGE_PAINT,
+    STAGE_COUNT
+};
+
 typedef char* string;
 typedef bool boolean;
 typedef int integer;
@@ -58,19 +189,28 @@ typedef struct Settings {
     #include "settings.def"
     #undef SETTING
     bool one_time;
+    bool daemon;                    // no hotkey, only controlled through the socket
 } Settings;
 
 // forward declarations
 
 static void launch_action(String, Action*);
 static void command_action(String, Action*);
+static void binary_action(String, Action*);
 static void edit_settings_action(String, Action*);
 static void* update_all(void*);
+static void update_all_async(void);
+static bool roots_watched(void);
+static void request_snapshot(void);
+static void record_usage(const Action*);
+static gboolean prefetch_collect(gpointer);
 
 // macros
 #define WELCOME_MESSAGE         "..."
 #define NO_MATCH_MESSAGE        "???"
 #define APPLICATION_ICON        "applications-other"
+#define EXECUTABLE_ICON         "application-x-executable"
+#define BINARY_KEY_PREFIX       "!bin:"
 #define DEFAULT_HOTKEY          "<Super>space"
 #define DEFAULT_ICON            GTK_STOCK_FIND
 #define NO_MATCH_ICON           GTK_STOCK_DIALOG_QUESTION
@@ -79,8 +219,37 @@ static void* update_all(void*);
 #define PI                      (0x1.921fb54442d18p+1)
 #define APPLICATIONS_DIR_0      "/usr/share/applications"
 #define APPLICATIONS_DIR_1      "/usr/local/share/applications"
-#define APPLICATIONS_DIR_2      "/usr/share/applications/kde4"
 #define USER_APPLICATIONS_DIR   ".local/share/applications"
+#define MAX_LAUNCHER_ROOTS      3
+#define SETTINGS_FILE_NAME      "fehlstart.rc"
+#define MNEMONICS_FILE_NAME     "actions.rc"
+#define JOURNAL_FILE_NAME       "actions.journal"
+#define JOURNAL_COMPACT_SIZE    256 // launches recorded before actions.rc is rewritten
+#define JOURNAL_GROUP           "!journal" // actions.rc group with the journal generation it holds
+#define COMMANDS_FILE_NAME      "commands.rc"
+#define INDEX_FILE_NAME         "launchers.idx"
+#define LATENCY_FILE_NAME       "latency.txt"
+#define INDEX_SAVE_DELAY        2   // seconds, coalesces bursts of package updates
+#define MAX_WATCHES             64
+#define SCAN_BATCH_SIZE         32  // files parsed per worker between map inserts
+#define MAX_SCAN_THREADS        8
+#define ARENA_BLOCK_SIZE        (64 * 1024)
+#define MIN_GARBAGE             (256 * 1024) // compact launchers when at least this much is wasted
+#define ICON_CACHE_SIZE         64
+#define TEXT_CACHE_SIZE         32  // measured labels, direct mapped
+#define MIN_FONT_SIZE           7
+#define PREFETCH_TOP            8   // icons of the best results decoded ahead of time
+#define PREFETCH_AROUND         2   // icons next to the selection decoded ahead of time
+#define FILTER_TOP_K            16  // results ordered right away, the rest when the user gets there
+#define TRIGRAM_MIN_QUERY       3   // shorter queries scan the whole corpus
+#define MNEMONIC_SCORE          100000 // above any text match
+#define MAX_LAUNCH_BONUS        30000 // mnemonic hits launched more often rank higher
+#define FUZZY_BAND              128 // fuzzy scores are below, substring scores above
+#define KEY_SCORE_BITS          17
+#define KEY_TIME_BITS           27  // minutes
+#define KEY_ID_BITS             20
+#define COMMAND_ARGS            "%a" // replaced by the arguments typed after the command
+#define SHELL_CHARACTERS        "|&;<>()$`*?[]{}~#" // outside of quotes in Exec
 #define COUNTOF(array)          (sizeof array / sizeof array[0])
 
 // preferences
@@ -88,35 +257,105 @@ static Settings settings = {
     #define SETTING(type, group, name, value) .group##_##name = value,
     #include "settings.def"
     #undef SETTING
-    .one_time = false
+    .one_time = false,
+    .daemon = false
 };
 
 // launcher stuff
 static GHashTable*      action_map;
 static GArray*          filter_list;
+static GArray*          filter_keys;        // uint64_t sort keys for filter_list
+static unsigned         filter_sorted;      // filter_list is in order up to here
 static unsigned         selection;
 static char             input_string[INPUT_STRING_SIZE];
 static unsigned         input_string_size;
-static pthread_mutex_t  map_mutex;
+static pthread_mutex_t  map_mutex;          // action_map and the actions, never taken while typing
+static pthread_mutex_t  update_mutex = PTHREAD_MUTEX_INITIALIZER; // one update_all at a time
+static Index            launcher_index;
+static Generation*      generation;         // launchers allocate here, protected by map_mutex
+static bool             index_dirty;        // launchers changed since the index was written
+static char             last_filter_buffer[INPUT_STRING_SIZE];
+static String           last_filter;        // query that produced filter_list
+static uint32_t*        filter_marks;       // ids already scored in this pass, by corpus id
+static uint32_t*        filter_candidates;  // ids from the trigram index
+static uint32_t         filter_marks_size;
+static uint32_t         filter_pass;
+
+// snapshots, the gui filters view while the snapshot thread publishes new ones
+static Snapshot*        published;          // latest snapshot, swapped atomically
+static Snapshot*        view;               // snapshot filter_list refers to, gui thread only
+static pthread_mutex_t  snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   snapshot_cond = PTHREAD_COND_INITIALIZER;
+static bool             snapshot_requested;
+
+// file system watcher
+static int              watch_fd = -1;
+static Watch            watches[MAX_WATCHES];
+static unsigned         watch_count;
+static int              config_wd = -1;
+static bool             watching;           // changes arrive via inotify, no rescans needed
+static guint            index_save_source;
+
+// executables in $PATH
+static ScanTree         launcher_tree;      // guarded by update_mutex
+static const char*      launcher_roots[MAX_LAUNCHER_ROOTS]; // application dirs, set up by main
+static unsigned         root_count;
+static PathCache        path_cache;
+static pthread_mutex_t  path_mutex = PTHREAD_MUTEX_INITIALIZER; // path_cache, one rescan at a time
+static GHashTable*      unclaimed;          // Unclaimed, until binaries_loaded, protected by map_mutex
+static bool             binaries_loaded;    // PATH was read once, protected by map_mutex
+
+// launches since actions.rc was written, protected by map_mutex
+static Journal          usage_journal = {-1, 0, 0};
+static uint64_t         saved_generation;   // last journal generation in actions.rc
+static bool             compacting;         // a thread is rewriting actions.rc
 
 // user interface
 static unsigned         hotkey_key;
 static GdkModifierType  hotkey_mod;
 static GdkPixbuf*       icon_pixbuf;
+static IconCache        icon_cache;
+
+// icon prefetching, jobs are queued by the gui thread and decoded by a worker
+static pthread_mutex_t  prefetch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   prefetch_cond = PTHREAD_COND_INITIALIZER;
+static GQueue           prefetch_todo = G_QUEUE_INIT;
+static GQueue           prefetch_done = G_QUEUE_INIT;
+static unsigned         prefetch_generation;
+static bool             prefetch_collect_pending;
 static GtkWidget*       window;
 static const char*      action_name;
+static Chrome           chrome;
+static Histogram        latency[STAGE_COUNT] = {
+    [STAGE_KEY] = {.name = "keystroke"},
+    [STAGE_LOCK] = {.name = "map_mutex_wait"},  // gui thread only, when launching
+    [STAGE_INPUT] = {.name = "text_input"},
+    [STAGE_FILTER] = {.name = "filter"},
+    [STAGE_SORT] = {.name = "sort"},
+    [STAGE_SHOW] = {.name = "show_selected"},
+    [STAGE_ICON] = {.name = "get_icon"},
+    [STAGE_PAINT] = {.name = "paint"},
+};
+static int              ipc_fd = -1;        // listening socket for fehlstart-client
+static char             ipc_path[IPC_PATH_SIZE];
+static TextFit          text_cache[TEXT_CACHE_SIZE];
 
 // files
+static char*            config_dir;
 static char*            setting_file;
 static char*            mnemonic_file;
+static char*            journal_file;
 static char*            commands_file;
 static char*            user_app_dir;
+static char*            index_file;
+static char*            latency_file;
+static char*            terminal;           // emulator for Terminal=true and binaries
 
 //------------------------------------------
 // helper functions
 
 inline static int imin(int a, int b) { return a < b ? a : b; }
-
+inline static int imax(int a, int b) { return a > b ? a : b; }
 inline static int iclamp(int v, int min, int max) { return v < min ? min : v > max ? max : v; }
 
 static bool is_readable_file(const char* file)
@@ -130,7 +369,9 @@ static bool is_readable_file(const char* file)
 static bool timestamp_changed(const char* file, time_t* timestamp)
 {
     struct stat st;
-    bool changed = !(stat(file, &st) && st.st_mtime == *timestamp);
+    if (stat(file, &st))
+        st.st_mtime = 0;
+    bool changed = st.st_mtime != *timestamp;
     *timestamp = st.st_mtime;
     return changed;
 }
@@ -156,6 +397,11 @@ static bool g_hash_table_contains(GHashTable* hash_table, gconstpointer key)
 {
     return g_hash_table_lookup_extended(hash_table, key, NULL, NULL);
 }
+
+static void g_hash_table_add(GHashTable* hash_table, gpointer key)
+{
+    g_hash_table_replace(hash_table, key, key);
+}
 #endif
 
 #if !GLIB_CHECK_VERSION(2,26,0)
@@ -173,6 +419,50 @@ static uint64_t g_key_file_get_uint64(GKeyFile* kf, const char* group, const cha
 }
 #endif
 
+#if !GLIB_CHECK_VERSION(2,30,0)
+// only one signal at a time, the handler writes to a pipe the main loop watches
+static int          signal_pipe[2] = {-1, -1};
+static GSourceFunc  signal_func;
+static gpointer     signal_data;
+
+static void signal_handler(int signum)
+{
+    int saved = errno;
+    char c = (char)signum;
+    if (write(signal_pipe[1], &c, 1) < 0) {} // a full pipe already has a signal pending
+    errno = saved;
+}
+
+static gboolean signal_event(GIOChannel* source, GIOCondition condition, gpointer data)
+{
+    char buffer[16];
+    while (read(signal_pipe[0], buffer, sizeof(buffer)) > 0);
+    signal_func(signal_data);
+    return true;
+}
+
+static guint g_unix_signal_add(int signum, GSourceFunc handler, gpointer user_data)
+{
+    if (signal_func || pipe(signal_pipe))
+        return 0;
+    for (int i = 0; i < 2; i++) {
+        fcntl(signal_pipe[i], F_SETFL, O_NONBLOCK);
+        fcntl(signal_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    signal_func = handler;
+    signal_data = user_data;
+    GIOChannel* channel = g_io_channel_unix_new(signal_pipe[0]);
+    guint id = g_io_add_watch(channel, G_IO_IN, signal_event, NULL);
+    g_io_channel_unref(channel);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(signum, &sa, NULL);
+    return id;
+}
+#endif
+
 //------------------------------------------
 // action functions
 
@@ -186,8 +476,34 @@ static void add_action(const char* name, const char* hint, const char* icon, voi
     a->action = action;
     a->used = true;
     g_hash_table_insert(action_map, a->key.str, a);
+    request_snapshot();
+}
+
+static void free_command(Command* c)
+{
+    if (!c)
+        return;
+    desktop_free_argv(c->argv);
+    free(c);
+}
+
+// returns NULL if exec is empty
+static Command* new_command(String exec, bool shell)
+{
+    char** argv = desktop_split(exec);
+    if (!argv)
+        return NULL;
+    Command* c = calloc(1, sizeof(Command));
+    c->argv = argv;
+    c->args = -1;
+    c->shell = shell;
+    for (int i = 0; argv[i]; i++)
+        if (!strcmp(argv[i], COMMAND_ARGS))
+            c->args = i;
+    return c;
 }
 
+// launchers live in a generation arena, str_free has no effect on their strings
 static void free_action(gpointer data)
 {
     Action* a = data;
@@ -196,79 +512,232 @@ static void free_action(gpointer data)
     str_free(a->icon);
     str_free(a->exec);
     str_free(a->mnemonic);
-    free(a);
+    free_command(a->command);
+    if (a->action != launch_action)
+        free(a);
+}
+
+static Generation* new_generation(void)
+{
+    Generation* g = calloc(1, sizeof(Generation));
+    arena_init(&g->arena, ARENA_BLOCK_SIZE);
+    return g;
 }
 
-static void load_launcher(String file, Action* action, bool match_executable)
+static void free_generation(Generation* g)
+{
+    if (!g)
+        return;
+    arena_free(&g->arena);
+    free(g);
+}
+
+// strings of the mapped index are neither freed nor copied
+static bool in_index(String s)
+{
+    return s.str >= launcher_index.data && s.str < launcher_index.data + launcher_index.size;
+}
+
+static size_t arena_bytes(String s)
+{
+    return s.len && !s.can_free && !in_index(s) ? s.len + 1 : 0;
+}
+
+static bool try_exec_found(String try_exec)
+{
+    if (try_exec.len == 0)
+        return true;
+    char* path = g_find_program_in_path(try_exec.str);
+    g_free(path);
+    return path != NULL;
+}
+
+// only name, executable and icon are kept, the rest is read again on launch
+// the executable is kept even if Matching/executable is off, it may hide the binary of that name
+static void load_launcher(String file, Action* action, Arena* arena)
 {
     timestamp_changed(file.str, &action->file_time);
     action->action = launch_action;
-    GDesktopAppInfo* info = g_desktop_app_info_new_from_filename(file.str);
-    if (!info)
-        return;
-    action->used = !g_desktop_app_info_get_is_hidden(info) && g_app_info_should_show(G_APP_INFO(info));
-    if (action->used) {
-        GAppInfo* app = G_APP_INFO(info);
-        action->name = str_new(g_app_info_get_name(app));
-        if (match_executable)
-            action->exec = str_new(g_app_info_get_executable(app));
-        GIcon* icon = g_app_info_get_icon(G_APP_INFO(app));
-        if (icon)
-            action->icon = str_own(g_icon_to_string(icon));
+    String buffer;
+    DesktopEntry entry;
+    if (desktop_load(file.str, &buffer, &entry)) {
+        action->used = !entry.hidden && try_exec_found(entry.try_exec);
+        if (action->used) {
+            action->name = str_arena_duplicate(arena, entry.name);
+            String exec = desktop_executable(entry.exec);
+            action->exec = str_arena_duplicate(arena, exec);
+            action->program = desktop_runs_program(entry.exec);
+            str_free(exec);
+            action->icon = str_arena_duplicate(arena, desktop_icon(entry.icon));
+        }
     }
-    g_object_unref(info);
+    str_free(buffer);
 }
 
-static void reload_launcher (Action* action, bool match_executable)
+// map_mutex must be held, the old strings stay in the arena until the next generation
+static void reload_launcher (Action* action)
 {
-    str_free(action->name);
-    str_free(action->exec);
-    str_free(action->icon);
-    action->used = false;
-    load_launcher(action->key, action, match_executable);
+    generation->garbage += arena_bytes(action->name) + arena_bytes(action->exec) + arena_bytes(action->icon);
+    action->name = action->exec = action->icon = STR_S("");
+    action->used = action->program = false;
+    load_launcher(action->key, action, &generation->arena);
 }
 
-static Action* new_launcher(String file, bool match_executable)
+static Action* new_launcher(String file, Arena* arena)
 {
-    Action* a = calloc(1, sizeof(Action));
-    a->key = file;
-    load_launcher(file, a, match_executable);
+    Action* a = arena_alloc(arena, sizeof(Action));
+    a->key = str_arena_duplicate(arena, file);
+    load_launcher(a->key, a, arena);
     return a;
 }
 
-static void update_launcher(gpointer key, gpointer value, gpointer user_data)
+static size_t launcher_bytes(const Action* a)
+{
+    return sizeof(Action) + arena_bytes(a->key) + arena_bytes(a->name) + arena_bytes(a->exec)
+        + arena_bytes(a->icon) + arena_bytes(a->mnemonic);
+}
+
+static void update_launcher(Action* a)
 {
-    Action* a = value;
     struct stat st;
-    if (a->action != launch_action)
-        return;
-    if (stat(a->key.str, &st))
-        a->used = false; // stat fails if file doesn't exist
-    else if (a->file_time != st.st_mtime)
-        reload_launcher(a, settings.Matching_executable);
+    bool missing = stat(a->key.str, &st) != 0; // stat fails if file doesn't exist
+    pthread_mutex_lock(&map_mutex);
+    if (missing) {
+        index_dirty |= a->file_time != 0;
+        if (a->used)
+            request_snapshot();
+        a->used = false;
+        a->file_time = 0;
+    } else if (a->file_time != st.st_mtime) {
+        reload_launcher(a);
+        index_dirty = true;
+        request_snapshot();
+    }
+    pthread_mutex_unlock(&map_mutex);
+}
+
+// check the known launchers the scan didn't see, action_map is only iterated with the lock held
+// launchers don't move while update_mutex is held, see compact_launchers()
+static void update_launchers(GHashTable* seen)
+{
+    GPtrArray* launchers = g_ptr_array_new();
+    pthread_mutex_lock(&map_mutex);
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+    g_hash_table_iter_init(&iter, action_map);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+        if (((Action*)value)->action == launch_action && !g_hash_table_contains(seen, value))
+            g_ptr_array_add(launchers, value);
+    pthread_mutex_unlock(&map_mutex);
+    for (unsigned i = 0; i < launchers->len; i++)
+        update_launcher(g_ptr_array_index(launchers, i));
+    g_ptr_array_free(launchers, true);
 }
 
-static void add_launchers(String dir_name)
+static void launcher_visit(ScanEvent event, const char* path, time_t mtime, void* data)
 {
-    DIR* dir = opendir(dir_name.str);
-    if (!dir)
+    LauncherScan* scan = data;
+    if (event == SCAN_DIR) {
+        g_ptr_array_add(scan->dirs, g_strdup(path));
         return;
-    struct dirent* ent = NULL;
-    while ((ent = readdir(dir))) {
-        String file_name = str_wrap(ent->d_name);
-        if (!str_ends_with_i(file_name, STR_S(".desktop")))
-            continue;
-        String full_path = str_join_path(dir_name, file_name);
-        if (g_hash_table_contains(action_map, full_path.str)) {
-            str_free(full_path);
-        } else {
-            pthread_mutex_lock(&map_mutex);
-            Action* launcher = new_launcher(full_path, settings.Matching_executable);
-            g_hash_table_insert(action_map, full_path.str, launcher);
-            pthread_mutex_unlock(&map_mutex);
+    }
+    pthread_mutex_lock(&map_mutex);
+    Action* a = g_hash_table_lookup(action_map, path);
+    if (a && event == SCAN_REMOVED) {
+        index_dirty |= a->file_time != 0;
+        if (a->used)
+            request_snapshot();
+        a->used = false;
+        a->file_time = 0;
+    } else if (a && a->file_time != mtime) {
+        reload_launcher(a);
+        index_dirty = true;
+        request_snapshot();
+    } else if (!a && event == SCAN_FILE) {
+        String file = str_new(path);
+        g_array_append_val(scan->files, file);
+    }
+    if (a && scan->seen)
+        g_hash_table_add(scan->seen, a);
+    pthread_mutex_unlock(&map_mutex);
+}
+
+// every worker fills its own arena and hands it to the current generation when done
+static void* scan_worker(void* data)
+{
+    ScanJob* job = data;
+    Action* batch[SCAN_BATCH_SIZE];
+    Arena arena;
+    arena_init(&arena, ARENA_BLOCK_SIZE);
+    for (;;) {
+        pthread_mutex_lock(&job->mutex);
+        unsigned begin = job->next;
+        unsigned count = imin(SCAN_BATCH_SIZE, job->files->len - begin);
+        job->next += count;
+        pthread_mutex_unlock(&job->mutex);
+        if (count == 0)
+            break;
+
+        for (unsigned i = 0; i < count; i++)
+            batch[i] = new_launcher(g_array_index(job->files, String, begin + i), &arena);
+
+        pthread_mutex_lock(&map_mutex);
+        for (unsigned i = 0; i < count; i++) {
+            // the watcher may have added the file in the meantime
+            if (g_hash_table_contains(action_map, batch[i]->key.str))
+                generation->garbage += launcher_bytes(batch[i]);
+            else
+                g_hash_table_insert(action_map, batch[i]->key.str, batch[i]);
         }
+        index_dirty = true;
+        request_snapshot();
+        pthread_mutex_unlock(&map_mutex);
     }
-    closedir(dir);
+    pthread_mutex_lock(&map_mutex);
+    arena_merge(&generation->arena, &arena);
+    pthread_mutex_unlock(&map_mutex);
+    return NULL;
+}
+
+// parse files in parallel, the calling thread takes part in the work
+static void load_launchers(GArray* files)
+{
+    ScanJob job = {files, 0, PTHREAD_MUTEX_INITIALIZER};
+    pthread_t threads[MAX_SCAN_THREADS];
+    int batches = (files->len + SCAN_BATCH_SIZE - 1) / SCAN_BATCH_SIZE;
+    int thread_count = imin(imin(sysconf(_SC_NPROCESSORS_ONLN), MAX_SCAN_THREADS), batches) - 1;
+    int started = 0;
+    for (; started < thread_count; started++)
+        if (pthread_create(threads + started, NULL, scan_worker, &job))
+            break;
+    scan_worker(&job);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&job.mutex);
+    for (unsigned i = 0; i < files->len; i++)
+        str_free(g_array_index(files, String, i));
+}
+
+static gboolean watch_dirs(gpointer data);
+
+// only directories that changed since the last scan are read, update_mutex must be held
+static void scan_launchers(const char* const* roots, uint32_t root_count)
+{
+    LauncherScan scan = {g_array_new(false, false, sizeof(String)), NULL, g_ptr_array_new_with_free_func(g_free)};
+    bool first = launcher_tree.root_count == 0;
+    if (first)
+        scan.seen = g_hash_table_new(NULL, NULL);
+    scan_update(&launcher_tree, roots, root_count, ".desktop", launcher_visit, &scan);
+    if (first) {
+        update_launchers(scan.seen); // the index may know files that are gone by now
+        g_hash_table_destroy(scan.seen);
+    }
+    load_launchers(scan.files);
+    g_array_free(scan.files, true);
+    if (scan.dirs->len)
+        g_idle_add(watch_dirs, scan.dirs);
+    else
+        g_ptr_array_free(scan.dirs, true);
 }
 
 static void update_commands(void)
@@ -277,6 +746,7 @@ static void update_commands(void)
     if (!timestamp_changed(commands_file, &commands_file_time))
         return;
 
+    pthread_mutex_lock(&map_mutex);
     GHashTableIter iter;
     gpointer key = NULL, value = NULL;
     g_hash_table_iter_init(&iter, action_map);
@@ -295,85 +765,569 @@ static void update_commands(void)
         if (a) {
             str_free(a->exec);
             str_free(a->icon);
+            free_command(a->command);
             str_free(key);
         } else {
             a = calloc(1, sizeof(Action));
             a->action = command_action;
             a->name = str_new(groups[i]);
             a->key = key;
-            pthread_mutex_lock(&map_mutex);
             g_hash_table_insert(action_map, key.str, a);
-            pthread_mutex_unlock(&map_mutex);
         }
         a->exec = str_own(g_key_file_get_string(kf, groups[i], "Exec", NULL));
         a->icon = str_own(g_key_file_get_string(kf, groups[i], "Icon", NULL));
-        a->used = true;
+        bool shell = g_key_file_get_boolean(kf, groups[i], "Shell", NULL);
+        a->command = new_command(a->exec, shell);
+        a->used = a->command != NULL;
+        if (!shell && strpbrk(a->exec.str, SHELL_CHARACTERS))
+            printf("command %s looks like shell syntax, add Shell=true if it needs a shell\n", groups[i]);
     }
+    request_snapshot();
+    pthread_mutex_unlock(&map_mutex);
     g_strfreev(groups);
     g_key_file_free(kf);
 }
 
+static void free_unclaimed(gpointer data)
+{
+    Unclaimed* u = data;
+    str_free(u->key);
+    str_free(u->mnemonic);
+    free(u);
+}
+
+// remember the usage of a binary that isn't in action_map yet, map_mutex must be held
+static Unclaimed* get_unclaimed(uint64_t key_hash)
+{
+    if (!unclaimed)
+        unclaimed = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, free_unclaimed);
+    Unclaimed* u = g_hash_table_lookup(unclaimed, &key_hash);
+    if (!u) {
+        u = calloc(1, sizeof(Unclaimed));
+        u->key_hash = key_hash;
+        g_hash_table_insert(unclaimed, &u->key_hash, u);
+    }
+    return u;
+}
+
+// true if some usage is only in the journal, clearing it would lose that
+static bool unclaimed_in_journal(void)
+{
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+    if (unclaimed)
+        g_hash_table_iter_init(&iter, unclaimed);
+    while (unclaimed && g_hash_table_iter_next(&iter, &key, &value))
+        if (((Unclaimed*)value)->key.len == 0)
+            return true;
+    return false;
+}
+
+// hand what load_mnemonics and open_journal kept over to a new binary action
+static void claim_usage(Action* a)
+{
+    uint64_t h = journal_hash(a->key);
+    Unclaimed* u = unclaimed ? g_hash_table_lookup(unclaimed, &h) : NULL;
+    if (!u)
+        return;
+    a->mnemonic = str_duplicate(u->mnemonic);
+    a->time = u->time;
+    a->launches = u->launches;
+    g_hash_table_remove(unclaimed, &h);
+}
+
+static void add_binaries(void)
+{
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+    g_hash_table_iter_init(&iter, action_map);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        Action* a = value;
+        if (a->action == binary_action)
+            a->used = false;
+    }
+    for (uint32_t i = 0; i < path_cache.count; i++) {
+        String name = str_wrap(path_cache.entries[i].name);
+        String key = str_concat(STR_S(BINARY_KEY_PREFIX), name);
+        Action* a = g_hash_table_lookup(action_map, key.str);
+        if (a) {
+            str_free(key);
+        } else {
+            a = calloc(1, sizeof(Action));
+            a->action = binary_action;
+            a->key = key;
+            a->name = str_duplicate(name);
+            a->exec = str_duplicate(name); // found through PATH again when launched
+            a->icon = str_new(EXECUTABLE_ICON);
+            claim_usage(a);
+            g_hash_table_insert(action_map, key.str, a);
+        }
+        a->used = true;
+    }
+}
+
+// executables in $PATH become actions, shadowed ones are left out
+// unchanged directories cost one stat each, so this is cheap enough for every show
+static void update_binaries(void)
+{
+    if (pthread_mutex_trylock(&path_mutex))
+        return; // a rescan is running
+    bool changed = false;
+    if (settings.Path_search) {
+        changed = path_update(&path_cache, getenv("PATH"));
+    } else if (path_cache.dir_count > 0) {
+        path_free(&path_cache);
+        changed = true;
+    }
+    if (changed || !binaries_loaded) {
+        pthread_mutex_lock(&map_mutex);
+        if (changed)
+            add_binaries();
+        request_snapshot();
+        binaries_loaded = true;
+        if (unclaimed)
+            g_hash_table_destroy(unclaimed); // left PATH since the last run
+        unclaimed = NULL;
+        pthread_mutex_unlock(&map_mutex);
+    }
+    pthread_mutex_unlock(&path_mutex);
+}
+
+static void* update_binaries_worker(void* data)
+{
+    update_binaries();
+    return NULL;
+}
+
+static void update_binaries_async(void)
+{
+    pthread_t thread = 0;
+    if (!pthread_create(&thread, NULL, update_binaries_worker, NULL))
+        pthread_detach(thread);
+}
+
 //------------------------------------------
-// filter functions
+// snapshot functions
 
-static void filter_scrore_add(gpointer key, gpointer value, gpointer user_data)
+static void free_snapshot(Snapshot* snap)
 {
-    Action* a = value;
-    String filter = *(String*)user_data;
-    if (!a->used)
+    corpus_free(&snap->corpus);
+    trigram_free(&snap->trigrams);
+    arena_free(&snap->arena);
+    free(snap);
+}
+
+static void unref_snapshot(Snapshot* snap)
+{
+    if (snap && --snap->refs == 0)
+        free_snapshot(snap);
+}
+
+// drops the reference published held, runs on the gui thread so view can't race with it
+static gboolean unref_snapshot_later(gpointer data)
+{
+    unref_snapshot(data);
+    return false;
+}
+
+// file names of the programs launchers stand for, map_mutex must be held
+// a binary of the same name is already in the list as its launcher
+// hidden launchers and wrappers like "env FOO=1 app" or "flatpak run" don't count
+static GHashTable* launcher_programs(void)
+{
+    GHashTable* programs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+    g_hash_table_iter_init(&iter, action_map);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        const Action* a = value;
+        if (a->used && a->program && a->action == launch_action && a->exec.len > 0) {
+            uint32_t begin = a->exec.len;
+            while (begin > 0 && a->exec.str[begin - 1] != '/')
+                begin--;
+            g_hash_table_add(programs, g_strndup(a->exec.str + begin, a->exec.len - begin));
+        }
+    }
+    return programs;
+}
+
+// runs on the snapshot thread, and on the calling thread for update_snapshot()
+// the used actions are copied under map_mutex, the trie and trigram index are built after it is released
+static Snapshot* build_snapshot(void)
+{
+    Snapshot* snap = calloc(1, sizeof(Snapshot));
+    arena_init(&snap->arena, ARENA_BLOCK_SIZE);
+    trie_init(&snap->mnemonics, &snap->arena);
+    snap->refs = 1; // held by published
+    pthread_mutex_lock(&map_mutex);
+    GHashTable* programs = launcher_programs();
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+    g_hash_table_iter_init(&iter, action_map);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        Action* a = value;
+        if (!a->used || (a->action == binary_action && g_hash_table_contains(programs, a->exec.str)))
+            continue;
+        SnapshotItem* item = arena_alloc(&snap->arena, sizeof(SnapshotItem));
+        item->key = str_arena_duplicate(&snap->arena, a->key);
+        item->name = str_arena_duplicate(&snap->arena, a->name);
+        item->icon = str_arena_duplicate(&snap->arena, a->icon);
+        item->time = a->time;
+        item->launches = a->launches;
+        String exec = a->action == launch_action && !settings.Matching_executable ? STR_S("") : a->exec;
+        uint32_t id = corpus_add(&snap->corpus, a->name, exec, a->mnemonic, item);
+        if (a->mnemonic.len > 0)
+            trie_add(&snap->mnemonics, a->mnemonic, id);
+    }
+    pthread_mutex_unlock(&map_mutex);
+    g_hash_table_destroy(programs);
+    trie_finish(&snap->mnemonics);
+    trigram_build(&snap->trigrams, &snap->corpus);
+    return snap;
+}
+
+// make snap the snapshot the gui picks up on its next full filter
+static void publish_snapshot(Snapshot* snap)
+{
+    Snapshot* old = __atomic_exchange_n(&published, snap, __ATOMIC_ACQ_REL);
+    if (old)
+        g_idle_add(unref_snapshot_later, old);
+}
+
+// build and publish right away, for startup and tools
+static void update_snapshot(void)
+{
+    pthread_mutex_lock(&snapshot_mutex);
+    snapshot_requested = false;
+    pthread_mutex_unlock(&snapshot_mutex);
+    publish_snapshot(build_snapshot());
+}
+
+// lock map_mutex from the gui thread and record how long it stalled
+static void lock_map(void)
+{
+    if (!pthread_mutex_trylock(&map_mutex)) {
+        histogram_add(&latency[STAGE_LOCK], 0);
         return;
+    }
+    uint64_t begin = latency_now();
+    pthread_mutex_lock(&map_mutex);
+    histogram_since(&latency[STAGE_LOCK], begin);
+}
 
-    a->score = -1;
-    if (str_starts_with(a->mnemonic, filter))
-        a->score = 100000;
+// ask the snapshot thread for a new snapshot, requests coalesce
+// may be called with map_mutex held
+static void request_snapshot(void)
+{
+    pthread_mutex_lock(&snapshot_mutex);
+    snapshot_requested = true;
+    pthread_cond_signal(&snapshot_cond);
+    pthread_mutex_unlock(&snapshot_mutex);
+}
 
-    if (a->score < 0) {
-        unsigned pos = str_find_first_i(a->name, filter);
-        if (pos != STR_END)
-            a->score = 100 + (filter.len - pos);
+static void* snapshot_worker(void* data)
+{
+    for (;;) {
+        pthread_mutex_lock(&snapshot_mutex);
+        while (!snapshot_requested)
+            pthread_cond_wait(&snapshot_cond, &snapshot_mutex);
+        snapshot_requested = false;
+        pthread_mutex_unlock(&snapshot_mutex);
+        publish_snapshot(build_snapshot());
     }
+    return NULL;
+}
+
+static void start_snapshot_thread(void)
+{
+    pthread_t thread = 0;
+    if (!pthread_create(&thread, NULL, snapshot_worker, NULL))
+        pthread_detach(thread);
+}
 
-    if (a->score < 0) {
-        unsigned pos = str_find_first_i(a->exec, filter);
+// switch view to the latest snapshot, gui thread only
+static void acquire_snapshot(void)
+{
+    Snapshot* snap = __atomic_load_n(&published, __ATOMIC_ACQUIRE);
+    if (snap == view)
+        return;
+    if (snap)
+        snap->refs++;
+    unref_snapshot(view);
+    view = snap;
+}
+
+static SnapshotItem* view_item(uint32_t id)
+{
+    return corpus_item(&view->corpus, id);
+}
+
+//------------------------------------------
+// filter functions
+
+// score of an entry whose mnemonic starts with the filter
+static int mnemonic_score(uint32_t id)
+{
+    return MNEMONIC_SCORE + imin(view_item(id)->launches, MAX_LAUNCH_BONUS) + 1;
+}
+
+// returns the score of corpus entry id for name and exec, which is positive if it matches the filter
+// folded is the lowercase filter, name and exec in the corpus are lowercase too
+// fuzzy matches score below FUZZY_BAND and rank below substring matches, fuzzy is NULL if disabled
+// whether an entry matches never depends on where, so a longer query only ever loses entries
+// and narrow_filter can start from the previous results
+static int text_score(const Corpus* corpus, uint32_t id, String filter, String folded, const FuzzyPattern* fuzzy)
+{
+    int score = -1;
+    unsigned pos = str_find_first(corpus_get(corpus, id, CORPUS_NAME), folded);
+    if (pos != STR_END)
+        score = imax(100 + (int)filter.len - (int)pos, 1);
+
+    if (score < 0) {
+        pos = str_find_first(corpus_get(corpus, id, CORPUS_EXEC), folded);
         if (pos != STR_END)
-            a->score = 1 + (filter.len - pos);
+            score = imax(1 + (int)filter.len - (int)pos, 1);
+    }
+    if (score > 0)
+        score += FUZZY_BAND;
+
+    if (score < 0 && fuzzy) {
+        int quality = fuzzy_score(fuzzy, corpus_get(corpus, id, CORPUS_NAME));
+        if (quality > 0)
+            score = 50 + quality / 2;
+        else if ((quality = fuzzy_score(fuzzy, corpus_get(corpus, id, CORPUS_EXEC))) > 0)
+            score = 1 + quality / 4;
+    }
+
+    if (score > 0)
+        score += corpus_get(corpus, id, CORPUS_MNEMONIC).len > 0;
+    return score;
+}
+
+static int filter_score(const Corpus* corpus, uint32_t id, String filter, String folded, const FuzzyPattern* fuzzy)
+{
+    if (str_starts_with(corpus_get(corpus, id, CORPUS_MNEMONIC), filter))
+        return mnemonic_score(id);
+    return text_score(corpus, id, filter, folded, fuzzy);
+}
+
+// score, last use and corpus id packed so that better results have larger keys
+// the id makes keys unique, corpora with more than 2^KEY_ID_BITS entries are not supported
+static uint64_t sort_key(uint32_t id, int score)
+{
+    const uint64_t id_mask = (1u << KEY_ID_BITS) - 1;
+    time_t time = view_item(id)->time;
+    uint64_t minutes = time > 0 ? (uint64_t)time / 60 : 0;
+    minutes = MIN(minutes, (1u << KEY_TIME_BITS) - 1);
+    score = imin(score, (1 << KEY_SCORE_BITS) - 1);
+    return (uint64_t)score << (KEY_TIME_BITS + KEY_ID_BITS) | minutes << KEY_ID_BITS | (id_mask - (id & id_mask));
+}
+
+static uint32_t key_id(uint64_t key)
+{
+    const uint64_t id_mask = (1u << KEY_ID_BITS) - 1;
+    return id_mask - (key & id_mask);
+}
+
+// filter_list gets the ids of all matches, filter_keys their sort keys
+static void add_match(uint32_t id, int score)
+{
+    uint64_t key = sort_key(id, score);
+    g_array_append_val(filter_list, id);
+    g_array_append_val(filter_keys, key);
+}
+
+// start a pass over the corpus of view, returns the marker for scored ids
+static uint32_t new_filter_pass(void)
+{
+    if (filter_marks_size < view->corpus.count) {
+        filter_marks = realloc(filter_marks, view->corpus.count * sizeof(uint32_t));
+        filter_candidates = realloc(filter_candidates, view->corpus.count * sizeof(uint32_t));
+        memset(filter_marks + filter_marks_size, 0, (view->corpus.count - filter_marks_size) * sizeof(uint32_t));
+        filter_marks_size = view->corpus.count;
+    }
+    if (++filter_pass == 0) {
+        memset(filter_marks, 0, filter_marks_size * sizeof(uint32_t));
+        filter_pass = 1;
     }
+    return filter_pass;
+}
 
-    if (a->score > 0) {
-        a->score += a->mnemonic.len > 0;
-        g_array_append_val(filter_list, a);
+// remembered hits come from the mnemonic trie, name and exec matches from the trigram index
+// fuzzy and short queries have no trigrams to go by and scan the whole corpus
+static void full_filter(String filter, String folded, const FuzzyPattern* fuzzy)
+{
+    g_array_set_size(filter_keys, 0);
+    if (!view)
+        return;
+    uint32_t pass = new_filter_pass();
+    uint32_t hits = 0;
+    const uint32_t* ids = trie_find_prefix(&view->mnemonics, filter, &hits);
+    for (uint32_t i = 0; i < hits; i++) {
+        filter_marks[ids[i]] = pass;
+        add_match(ids[i], mnemonic_score(ids[i]));
+    }
+    if (folded.len >= TRIGRAM_MIN_QUERY && !fuzzy) {
+        uint32_t count = trigram_candidates(&view->trigrams, folded, filter_candidates);
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t id = filter_candidates[i];
+            int score = filter_marks[id] == pass ? -1 : text_score(&view->corpus, id, filter, folded, fuzzy);
+            if (score > 0)
+                add_match(id, score);
+        }
+        return;
+    }
+    for (uint32_t i = 0; i < view->corpus.count; i++) {
+        if (filter_marks[i] == pass)
+            continue;
+        int score = text_score(&view->corpus, i, filter, folded, fuzzy);
+        if (score > 0)
+            add_match(i, score);
     }
 }
 
-static int compare_score(gconstpointer a, gconstpointer b)
+// a query that extends the last one can only match a subset of its results
+// unless a new snapshot came in
+static bool can_narrow_filter(String filter)
 {
-    Action* a1 = *(Action**)a;
-    Action* a2 = *(Action**)b;
-    return (a2->score - a1->score) + (a2->time < a1->time ? -1 : 1);
+    return view == __atomic_load_n(&published, __ATOMIC_ACQUIRE) && last_filter.len > 0
+        && filter.len > last_filter.len && str_starts_with(filter, last_filter);
 }
 
-static void filter_action_list(String filter)
+static void narrow_filter(String filter, String folded, const FuzzyPattern* fuzzy)
 {
-    if (filter_list->len)
-        g_array_remove_range(filter_list, 0, filter_list->len);
-    if (filter.len == 0)
+    unsigned count = 0;
+    for (unsigned i = 0; i < filter_list->len; i++) {
+        uint32_t id = g_array_index(filter_list, uint32_t, i);
+        int score = filter_score(&view->corpus, id, filter, folded, fuzzy);
+        if (score > 0) {
+            g_array_index(filter_list, uint32_t, count) = id;
+            g_array_index(filter_keys, uint64_t, count++) = sort_key(id, score);
+        }
+    }
+    g_array_set_size(filter_list, count);
+    g_array_set_size(filter_keys, count);
+}
+
+static int compare_key(const void* a, const void* b)
+{
+    uint64_t k1 = *(const uint64_t*)a;
+    uint64_t k2 = *(const uint64_t*)b;
+    return (k1 < k2) - (k1 > k2); // descending
+}
+
+inline static void swap_keys(uint64_t* a, uint64_t* b)
+{
+    uint64_t t = *a;
+    *a = *b;
+    *b = t;
+}
+
+// moves the k largest keys to the front in no particular order, like nth_element
+static void select_top_keys(uint64_t* keys, unsigned n, unsigned k)
+{
+    unsigned lo = 0, hi = n;
+    while (hi - lo > 1 && k > lo && k < hi) {
+        swap_keys(keys + lo + (hi - lo) / 2, keys + hi - 1);
+        uint64_t pivot = keys[hi - 1];
+        unsigned store = lo;
+        for (unsigned i = lo; i < hi - 1; i++)
+            if (keys[i] > pivot)
+                swap_keys(keys + i, keys + store++);
+        swap_keys(keys + store, keys + hi - 1);
+        if (k == store || k == store + 1)
+            return;
+        if (k < store)
+            hi = store;
+        else
+            lo = store + 1;
+    }
+}
+
+static void apply_keys(unsigned begin)
+{
+    for (unsigned i = begin; i < filter_keys->len; i++)
+        g_array_index(filter_list, uint32_t, i) = key_id(g_array_index(filter_keys, uint64_t, i));
+}
+
+// only the top results are ordered, see sort_filter_list_until()
+static void sort_filter_list(void)
+{
+    uint64_t begin = latency_now();
+    unsigned n = filter_keys->len;
+    uint64_t* keys = (uint64_t*)filter_keys->data;
+    filter_sorted = imin(FILTER_TOP_K, n);
+    if (n > filter_sorted)
+        select_top_keys(keys, n, filter_sorted);
+    qsort(keys, filter_sorted, sizeof(uint64_t), compare_key);
+    apply_keys(0);
+    histogram_since(&latency[STAGE_SORT], begin);
+}
+
+// order the rest of the list once the selection leaves the top results
+static void sort_filter_list_until(unsigned index)
+{
+    if (index < filter_sorted || filter_sorted >= filter_keys->len || filter_keys->len != filter_list->len)
         return;
-    g_hash_table_foreach(action_map, filter_scrore_add, &filter);
-    g_array_sort(filter_list, compare_score);
+    uint64_t begin = latency_now();
+    uint64_t* keys = (uint64_t*)filter_keys->data;
+    qsort(keys + filter_sorted, filter_keys->len - filter_sorted, sizeof(uint64_t), compare_key);
+    apply_keys(filter_sorted);
+    filter_sorted = filter_keys->len;
+    histogram_since(&latency[STAGE_SORT], begin);
+}
+
+// runs on the gui thread without taking map_mutex
+static void filter_action_list(String filter)
+{
+    uint64_t begin = latency_now();
+    bool narrow = can_narrow_filter(filter);
+    strncpy(last_filter_buffer, filter.str, filter.len);
+    last_filter = str_wrap_n(last_filter_buffer, filter.len);
+
+    char folded_buffer[INPUT_STRING_SIZE];
+    strncpy(folded_buffer, filter.str, filter.len);
+    String folded = str_to_lower(str_wrap_n(folded_buffer, filter.len));
+    FuzzyPattern pattern;
+    if (settings.Matching_fuzzy)
+        fuzzy_compile(&pattern, folded);
+    const FuzzyPattern* fuzzy = settings.Matching_fuzzy ? &pattern : NULL;
+
+    if (narrow) {
+        narrow_filter(filter, folded, fuzzy);
+    } else {
+        g_array_set_size(filter_list, 0);
+        g_array_set_size(filter_keys, 0);
+        if (filter.len == 0) {
+            histogram_since(&latency[STAGE_FILTER], begin);
+            return;
+        }
+        acquire_snapshot();
+        full_filter(filter, folded, fuzzy);
+    }
+    histogram_since(&latency[STAGE_FILTER], begin); // sort_filter_list records its own time
+    sort_filter_list();
 }
 
 static void run_selected(void)
 {
     if (!filter_list->len || selection >= filter_list->len)
         return;
-    Action* a = g_array_index(filter_list, Action*, selection);
-    if (!a->action != 0)
-        return;
-    str_free(a->mnemonic);
-    a->mnemonic = str_duplicate(get_first_input_word());
-    a->time = time(NULL);
-    String str = str_wrap_n(input_string, input_string_size);
-    a->action(str, a);
+    SnapshotItem* item = view_item(g_array_index(filter_list, uint32_t, selection));
+    lock_map();
+    Action* a = g_hash_table_lookup(action_map, item->key.str);
+    if (a && a->action) {
+        str_free(a->mnemonic);
+        a->mnemonic = str_duplicate(get_first_input_word());
+        a->time = time(NULL);
+        a->launches++;
+        record_usage(a);
+        index_dirty |= a->action == launch_action;
+        request_snapshot(); // mnemonic is part of the corpus
+        String str = str_wrap_n(input_string, input_string_size);
+        a->action(str, a);
+    }
+    pthread_mutex_unlock(&map_mutex);
 }
 
 //------------------------------------------
@@ -401,27 +1355,52 @@ static Color parse_color(const char* color_name, GdkColor default_color)
     return col;
 }
 
-static void draw_labels(cairo_t* cr, Settings* set, GtkStyle* sty, const char* action, const char* input)
+static void text_cache_clear(void)
 {
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        g_free(text_cache[i].text);
+        text_cache[i].text = NULL;
+    }
+}
+
+// shrink the font from size until text fits into max_width, results are cached
+// since the same titles are measured again on every keystroke
+static const TextFit* fit_text(cairo_t* cr, const char* text, int size, int max_width)
+{
+    unsigned slot = (g_str_hash(text) ^ (size * 31u) ^ max_width) % TEXT_CACHE_SIZE;
+    TextFit* f = text_cache + slot;
+    if (f->text && f->size == size && f->max_width == max_width && !strcmp(f->text, text))
+        return f;
+
     cairo_text_extents_t extents;
-    Color c = parse_color(set->Labels_color, sty->text[GTK_STATE_SELECTED]);
+    int fit_size = size + 1;
+    do {
+        cairo_set_font_size(cr, --fit_size);
+        cairo_text_extents(cr, text, &extents);
+    } while (extents.width > max_width && fit_size > MIN_FONT_SIZE);
+
+    g_free(f->text);
+    *f = (TextFit) {g_strdup(text), size, max_width, fit_size, extents.width};
+    return f;
+}
+
+static void draw_labels(cairo_t* cr, Settings* set, Color c, const char* action, const char* input)
+{
     cairo_set_source_rgb(cr, c.r, c.g, c.b);
 
     int max_width = set->Window_width - set->Border_width * 2;
-    int size = set->Labels_size1;
-    do {
-        cairo_set_font_size(cr, size--);
-        cairo_text_extents(cr, action, &extents);
-    } while (extents.width > max_width && size > 6);
-    double x = (set->Window_width - extents.width) / 2.0;
+    const TextFit* f = fit_text(cr, action, set->Labels_size1, max_width);
+    cairo_set_font_size(cr, f->fit_size);
+    double x = (set->Window_width - f->width) / 2.0;
     double y = set->Window_height * 0.75;
     cairo_move_to(cr, x, y);
     cairo_show_text(cr, action);
 
     if (set->Labels_showinput) {
-        cairo_set_font_size(cr, set->Labels_size2);
-        cairo_text_extents(cr, input, &extents);
-        x = (set->Window_width - extents.width) / 2.0;
+        // a fixed size, max_width of INT_MAX never shrinks it
+        f = fit_text(cr, input, set->Labels_size2, INT_MAX);
+        cairo_set_font_size(cr, f->fit_size);
+        x = (set->Window_width - f->width) / 2.0;
         y = set->Window_height - set->Border_width * 2.0;
         cairo_move_to(cr, x, y);
         cairo_show_text(cr, input);
@@ -438,14 +1417,13 @@ static void draw_icon(cairo_t* cr, Settings* set, GdkPixbuf* icon)
     cairo_paint(cr);
 }
 
-static void draw_dots(cairo_t* cr, Settings* set, GtkStyle* sty, int index, int max)
+static void draw_dots(cairo_t* cr, Settings* set, Color c, int index, int max)
 {
     if (max < 1)
         return;
     double r = 2.0; // circle radius
     double w = set->Window_width;
     double y = set->Window_height / 2.0;
-    Color c = parse_color(set->Labels_color, sty->text[GTK_STATE_SELECTED]);
 
     for (int i = 0; i < imin(3, index); i++)
         cairo_arc(cr, r * 3 * (i + 1), y, r, 0, 2 * PI);
@@ -457,17 +1435,27 @@ static void draw_dots(cairo_t* cr, Settings* set, GtkStyle* sty, int index, int
     cairo_fill(cr);
 }
 
-static void draw_window(cairo_t* cr, Settings* set, GtkStyle* sty)
+static double corner_radius(Settings* set)
+{
+    return set->Window_round ? fmax(set->Window_width, set->Window_height) / 10 : 0;
+}
+
+// keep icon and labels inside the rounded corners
+static void clip_window(cairo_t* cr, Settings* set)
+{
+    rectangle(cr, 0, 0, set->Window_width, set->Window_height, corner_radius(set));
+    cairo_clip(cr);
+}
+
+static void draw_window(cairo_t* cr, Settings* set, Color c, Color border)
 {
     double w = set->Window_width;
     double h = set->Window_height;
-    double brad = set->Window_round ? fmax(w, h) / 10 : 0; // corner radius
+    double brad = corner_radius(set);
     double w2 = w / 2, h3 = w * 3;
     double crad = sqrt(w2 * w2 + h3 * h3);
-    Color c = parse_color(set->Window_color, sty->bg[GTK_STATE_SELECTED]);
 
-    rectangle(cr, 0, 0, w, h, brad);
-    cairo_clip(cr);
+    clip_window(cr, set);
 
     cairo_set_source_rgb(cr, c.r, c.g, c.b);
     cairo_paint(cr);
@@ -482,45 +1470,260 @@ static void draw_window(cairo_t* cr, Settings* set, GtkStyle* sty)
         cairo_fill(cr);
     }
 
-    c = parse_color(set->Border_color, sty->text[GTK_STATE_SELECTED]);
-    rectangle(cr, 0, 0, w, h, brad);
-    cairo_set_line_width(cr, set->Border_width * 2);
-    cairo_set_source_rgb(cr, c.r, c.g, c.b);
-    cairo_stroke(cr);
+    rectangle(cr, 0, 0, w, h, brad);
+    cairo_set_line_width(cr, set->Border_width * 2);
+    cairo_set_source_rgb(cr, border.r, border.g, border.b);
+    cairo_stroke(cr);
+}
+
+static void clear(cairo_t* cr)
+{
+    cairo_set_source_rgba(cr, 0, 0, 0, 0);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+}
+
+static void invalidate_chrome(void)
+{
+    chrome.valid = false;
+}
+
+// resolve colors and render the static parts of the window once
+static void update_chrome(cairo_t* cr, Settings* set, GtkStyle* sty)
+{
+    if (chrome.valid && chrome.surface)
+        return;
+    if (chrome.surface)
+        cairo_surface_destroy(chrome.surface);
+    chrome.valid = true;
+    text_cache_clear(); // font options may differ on the new target
+    chrome.window = parse_color(set->Window_color, sty->bg[GTK_STATE_SELECTED]);
+    chrome.border = parse_color(set->Border_color, sty->text[GTK_STATE_SELECTED]);
+    chrome.label = parse_color(set->Labels_color, sty->text[GTK_STATE_SELECTED]);
+    chrome.surface = cairo_surface_create_similar(cairo_get_target(cr), CAIRO_CONTENT_COLOR_ALPHA,
+        set->Window_width, set->Window_height);
+    cairo_t* scr = cairo_create(chrome.surface);
+    clear(scr);
+    draw_window(scr, set, chrome.window, chrome.border);
+    cairo_destroy(scr);
+}
+
+static int icon_size(Settings* set)
+{
+    const int sizes[] = {256, 128, 48, 32};
+    // if the size is uncommon, svgs might be used which load
+    // too slow on my atom machine
+    int h = set->Window_height / 2;
+    if (!set->Icons_scale) {
+        int i = 0;
+        for (; i < (int)COUNTOF(sizes) && h < sizes[i]; i++) {}
+        h = sizes[i];
+    }
+    return h;
+}
+
+static GdkPixbuf* load_icon(const char* name, int h)
+{
+    if (g_path_is_absolute(name)) {
+        return gdk_pixbuf_new_from_file_at_scale(name, -1, h, true, NULL);
+    } else {
+        int flags = GTK_ICON_LOOKUP_FORCE_SIZE | GTK_ICON_LOOKUP_USE_BUILTIN;
+        GtkIconTheme* theme = gtk_icon_theme_get_default();
+        return gtk_icon_theme_load_icon(theme, name, h, flags, NULL);
+    }
+}
+
+static void free_icon_entry(IconEntry* e)
+{
+    if (e->pixbuf)
+        g_object_unref(e->pixbuf);
+    g_free(e->key);
+    free(e);
+}
+
+static void icon_cache_clear(void)
+{
+    GList* link = NULL;
+    while ((link = g_queue_pop_head_link(&icon_cache.lru))) {
+        IconEntry* e = link->data;
+        g_hash_table_remove(icon_cache.map, e->key);
+        free_icon_entry(e);
+    }
+}
+
+static void icon_theme_changed(GtkIconTheme* theme, gpointer data)
+{
+    icon_cache_clear();
+}
+
+// a different icon size (Window_height, Icons_scale) empties the cache
+static int icon_cache_size(Settings* set)
+{
+    int size = icon_size(set);
+    if (size != icon_cache.size) {
+        icon_cache_clear();
+        icon_cache.size = size;
+    }
+    return size;
+}
+
+// takes ownership of key and pixbuf
+static IconEntry* icon_cache_add(char* key, GdkPixbuf* pixbuf)
+{
+    if (icon_cache.lru.length >= ICON_CACHE_SIZE) {
+        IconEntry* old = g_queue_pop_tail_link(&icon_cache.lru)->data;
+        g_hash_table_remove(icon_cache.map, old->key);
+        free_icon_entry(old);
+    }
+    IconEntry* e = calloc(1, sizeof(IconEntry));
+    e->key = key;
+    e->pixbuf = pixbuf;
+    e->link.data = e;
+    g_hash_table_insert(icon_cache.map, e->key, e);
+    g_queue_push_head_link(&icon_cache.lru, &e->link);
+    return e;
+}
+
+// returns a new reference, decoded icons are kept in a lru cache
+static GdkPixbuf* get_icon(const char* name, Settings* set)
+{
+    if (!set->Icons_show)
+        return NULL;
+    int size = icon_cache_size(set);
+    char* key = g_strdup_printf("%d:%s", size, name);
+    IconEntry* e = g_hash_table_lookup(icon_cache.map, key);
+    if (e) {
+        icon_cache.hits++;
+        g_queue_unlink(&icon_cache.lru, &e->link);
+        g_queue_push_head_link(&icon_cache.lru, &e->link);
+        g_free(key);
+    } else {
+        icon_cache.misses++;
+        e = icon_cache_add(key, load_icon(name, size));
+    }
+    return e->pixbuf ? g_object_ref(e->pixbuf) : NULL;
+}
+
+//------------------------------------------
+// icon prefetching
+
+static void free_icon_job(IconJob* job)
+{
+    if (job->pixbuf)
+        g_object_unref(job->pixbuf);
+    g_free(job->key);
+    g_free(job->file);
+    free(job);
+}
+
+// decoding is the slow part and gdk-pixbuf can do it off the gui thread,
+// theme lookups are not thread safe and are done by prefetch_icons()
+static void* prefetch_worker(void* data)
+{
+    pthread_mutex_lock(&prefetch_mutex);
+    for (;;) {
+        while (g_queue_is_empty(&prefetch_todo))
+            pthread_cond_wait(&prefetch_cond, &prefetch_mutex);
+        IconJob* job = g_queue_pop_head(&prefetch_todo);
+        if (job->generation != prefetch_generation) {
+            free_icon_job(job);
+            continue;
+        }
+        pthread_mutex_unlock(&prefetch_mutex);
+        job->pixbuf = gdk_pixbuf_new_from_file_at_scale(job->file, job->width, job->height, true, NULL);
+        pthread_mutex_lock(&prefetch_mutex);
+        g_queue_push_tail(&prefetch_done, job);
+        if (!prefetch_collect_pending) {
+            prefetch_collect_pending = true;
+            g_idle_add(prefetch_collect, NULL);
+        }
+    }
+    return NULL;
 }
 
-static void clear(cairo_t* cr)
+// moves decoded icons into the cache, runs on the gui thread
+static gboolean prefetch_collect(gpointer data)
 {
-    cairo_set_source_rgba(cr, 0, 0, 0, 0);
-    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
-    cairo_paint(cr);
-    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    pthread_mutex_lock(&prefetch_mutex);
+    GQueue done = prefetch_done;
+    g_queue_init(&prefetch_done);
+    prefetch_collect_pending = false;
+    pthread_mutex_unlock(&prefetch_mutex);
+
+    IconJob* job = NULL;
+    while ((job = g_queue_pop_head(&done))) {
+        if (job->pixbuf && !g_hash_table_contains(icon_cache.map, job->key)) {
+            icon_cache_add(job->key, job->pixbuf);
+            job->key = NULL;
+            job->pixbuf = NULL;
+        }
+        free_icon_job(job);
+    }
+    return false;
 }
 
-static GdkPixbuf* load_icon(const char* name, Settings* set)
+static void queue_icon_job(const char* name, int size)
 {
-    const int sizes[] = {256, 128, 48, 32};
-    if (!set->Icons_show)
-        return NULL;
-    // if the size is uncommon, svgs might be used which load
-    // too slow on my atom machine
-    int h = set->Window_height / 2;
-    if (!set->Icons_scale) {
-        int i = 0;
-        for (; i < (int)COUNTOF(sizes) && h < sizes[i]; i++) {}
-        h = sizes[i];
+    if (!name[0])
+        return;
+    char* key = g_strdup_printf("%d:%s", size, name);
+    if (g_hash_table_contains(icon_cache.map, key)) {
+        g_free(key);
+        return;
     }
+    IconJob* job = calloc(1, sizeof(IconJob));
+    job->key = key;
+    job->height = size;
+    job->generation = prefetch_generation;
     if (g_path_is_absolute(name)) {
-        return gdk_pixbuf_new_from_file_at_scale(name, -1, h, true, NULL);
+        job->file = g_strdup(name);
+        job->width = -1;
     } else {
-        int flags = GTK_ICON_LOOKUP_FORCE_SIZE | GTK_ICON_LOOKUP_USE_BUILTIN;
-        GtkIconTheme* theme = gtk_icon_theme_get_default();
-        return gtk_icon_theme_load_icon(theme, name, h, flags, NULL);
+        GtkIconInfo* info = gtk_icon_theme_lookup_icon(gtk_icon_theme_get_default(), name, size, GTK_ICON_LOOKUP_FORCE_SIZE);
+        if (info) {
+            job->file = g_strdup(gtk_icon_info_get_filename(info)); // builtin icons have no file
+            job->width = size;
+            gtk_icon_info_free(info);
+        }
+    }
+    if (job->file)
+        g_queue_push_tail(&prefetch_todo, job);
+    else
+        free_icon_job(job);
+}
+
+// queue the icons of the best results and the ones around the selection,
+// jobs that were queued for an older query or selection are dropped
+static void prefetch_icons(void)
+{
+    if (!settings.Icons_show)
+        return;
+    int size = icon_cache_size(&settings);
+    pthread_mutex_lock(&prefetch_mutex);
+    prefetch_generation++;
+    unsigned n = filter_list->len;
+    for (unsigned i = 0; i < MIN(PREFETCH_TOP, n); i++)
+        queue_icon_job(view_item(g_array_index(filter_list, uint32_t, i))->icon.str, size);
+    for (int d = -PREFETCH_AROUND; n && d <= PREFETCH_AROUND; d++) {
+        unsigned i = (selection + n + d) % n;
+        if (i < filter_sorted)
+            queue_icon_job(view_item(g_array_index(filter_list, uint32_t, i))->icon.str, size);
     }
+    pthread_cond_signal(&prefetch_cond);
+    pthread_mutex_unlock(&prefetch_mutex);
+}
+
+static void start_prefetcher(void)
+{
+    pthread_t thread = 0;
+    if (!pthread_create(&thread, NULL, prefetch_worker, NULL))
+        pthread_detach(thread);
 }
 
 static void show_selected(void)
 {
+    uint64_t begin = latency_now();
     const char* icon_name = NO_MATCH_ICON;
     action_name = NO_MATCH_MESSAGE;
 
@@ -528,19 +1731,24 @@ static void show_selected(void)
         action_name = WELCOME_MESSAGE;
         icon_name = DEFAULT_ICON;
     } else if (filter_list->len > 0) {
-        Action* a = g_array_index(filter_list, Action*, selection);
-        action_name = a->name.str;
-        icon_name = a->icon.str;
+        SnapshotItem* item = view_item(g_array_index(filter_list, uint32_t, selection));
+        action_name = item->name.str;
+        icon_name = item->icon.str;
     }
 
     if (icon_pixbuf)
         g_object_unref(icon_pixbuf);
-    icon_pixbuf = load_icon(icon_name, &settings);
+    uint64_t icon_begin = latency_now();
+    icon_pixbuf = get_icon(icon_name, &settings);
+    histogram_since(&latency[STAGE_ICON], icon_begin);
     gtk_widget_queue_draw(window);
+    prefetch_icons();
+    histogram_since(&latency[STAGE_SHOW], begin);
 }
 
 static void handle_text_input(GdkEventKey* event)
 {
+    uint64_t begin = latency_now();
     if (event->keyval == GDK_BackSpace && input_string_size > 0)
         input_string_size--;
     else if (event->length == 1 &&
@@ -551,6 +1759,7 @@ static void handle_text_input(GdkEventKey* event)
     input_string[input_string_size] = 0;
     filter_action_list(get_first_input_word());
     selection = 0;
+    histogram_since(&latency[STAGE_INPUT], begin);
 }
 
 static void hide_window(void)
@@ -569,6 +1778,7 @@ static void hide_window(void)
     selection = 0;
     if (filter_list->len)
         g_array_remove_range(filter_list, 0, filter_list->len);
+    last_filter = STR_S("");
 }
 
 static void show_window(void)
@@ -576,8 +1786,10 @@ static void show_window(void)
     if (gtk_widget_get_visible(window))
         return;
 
-    pthread_t thread = 0;
-    pthread_create(&thread, NULL, update_all, NULL);
+    if (!watching || !roots_watched())
+        update_all_async();
+    else
+        update_binaries_async(); // PATH isn't watched
     show_selected();
     gtk_widget_set_size_request(window, settings.Window_width, settings.Window_height);
     gtk_window_set_position(GTK_WINDOW(window), GTK_WIN_POS_CENTER_ALWAYS);
@@ -613,7 +1825,7 @@ static gboolean delete_event(GtkWidget* widget, GdkEvent* event, gpointer data)
 
 static gboolean key_press_event(GtkWidget* widget, GdkEventKey* event, gpointer data)
 {
-    pthread_mutex_lock(&map_mutex);
+    uint64_t begin = latency_now();
     switch (event->keyval) {
     case GDK_Escape:
         hide_window();
@@ -627,6 +1839,7 @@ static gboolean key_press_event(GtkWidget* widget, GdkEventKey* event, gpointer
     case GDK_Up:
         if (filter_list->len)
             selection = (selection + filter_list->len - 1) % filter_list->len;
+        sort_filter_list_until(selection);
         show_selected();
         break;
     case GDK_Right:
@@ -634,6 +1847,7 @@ static gboolean key_press_event(GtkWidget* widget, GdkEventKey* event, gpointer
     case GDK_Down:
         if (filter_list->len)
             selection = (selection + 1) % filter_list->len;
+        sort_filter_list_until(selection);
         show_selected();
         break;
     default:
@@ -646,7 +1860,7 @@ static gboolean key_press_event(GtkWidget* widget, GdkEventKey* event, gpointer
         show_selected();
         break;
     }
-    pthread_mutex_unlock(&map_mutex);
+    histogram_since(&latency[STAGE_KEY], begin);
     return true;
 }
 
@@ -657,18 +1871,30 @@ static void screen_changed(GtkWidget *widget, GdkScreen *old_screen, gpointer us
     if (!colormap)
         colormap = gdk_screen_get_rgb_colormap(screen);
     gtk_widget_set_colormap(widget, colormap);
+    icon_cache_clear(); // the default icon theme depends on the screen
+    invalidate_chrome();
+}
+
+static void style_set(GtkWidget* widget, GtkStyle* previous, gpointer data)
+{
+    invalidate_chrome();
 }
 
 static gboolean expose_event(GtkWidget *widget, GdkEvent *event, gpointer data)
 {
+    uint64_t begin = latency_now();
     cairo_t* cr = gdk_cairo_create(widget->window);
-    GtkStyle* sty = gtk_widget_get_style(window);
-    clear(cr);
-    draw_window(cr, &settings, sty);
+    update_chrome(cr, &settings, gtk_widget_get_style(window));
+    cairo_set_source_surface(cr, chrome.surface, 0, 0);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    clip_window(cr, &settings);
     draw_icon(cr, &settings, icon_pixbuf);
-    draw_dots(cr, &settings, sty, selection, filter_list->len);
-    draw_labels(cr, &settings, sty, action_name, input_string);
+    draw_dots(cr, &settings, chrome.label, selection, filter_list->len);
+    draw_labels(cr, &settings, chrome.label, action_name, input_string);
     cairo_destroy(cr);
+    histogram_since(&latency[STAGE_PAINT], begin);
     return false;
 }
 
@@ -685,6 +1911,11 @@ static void create_widgets(void)
     g_signal_connect(window, "button-press-event", G_CALLBACK(button_press_event), NULL);
     g_signal_connect(window, "expose-event", G_CALLBACK(expose_event), NULL);
     g_signal_connect(window, "screen-changed", G_CALLBACK(screen_changed), NULL);
+    g_signal_connect(window, "style-set", G_CALLBACK(style_set), NULL);
+
+    icon_cache.map = g_hash_table_new(g_str_hash, g_str_equal);
+    g_queue_init(&icon_cache.lru);
+    g_signal_connect(gtk_icon_theme_get_default(), "changed", G_CALLBACK(icon_theme_changed), NULL);
 
     screen_changed(window, NULL, NULL);
 }
@@ -692,23 +1923,22 @@ static void create_widgets(void)
 //------------------------------------------
 // misc
 
-static void key_file_save(GKeyFile* kf, const char* file_name)
+// written to a temporary file that replaces file_name, a crash leaves the old one
+static bool key_file_save(GKeyFile* kf, const char* file_name)
 {
-    FILE* f = fopen(file_name, "w");
-    if (!f)
-        return;
     gsize length = 0;
     char* data = g_key_file_to_data(kf, &length, NULL);
-    fwrite(data, 1, length, f);
+    bool ok = data && g_file_set_contents(file_name, data, length, NULL);
     g_free(data);
-    fclose(f);
+    return ok;
 }
 
-void read_settings(const char* file_name, Settings* set)
+// returns true if the file changed and was read again
+bool read_settings(const char* file_name, Settings* set)
 {
     static time_t config_file_time;
     if (!timestamp_changed(file_name, &config_file_time))
-        return;
+        return false;
 
     GKeyFile *kf = g_key_file_new();
     if (g_key_file_load_from_file(kf, file_name, G_KEY_FILE_NONE, NULL)) {
@@ -723,6 +1953,8 @@ void read_settings(const char* file_name, Settings* set)
     set->Window_height = iclamp(set->Window_height, 100, 800);
     set->Labels_size1 = iclamp(set->Labels_size1, 6, 32);
     set->Labels_size2 = iclamp(set->Labels_size2, 6, 32);
+    request_snapshot(); // matching settings affect filter results
+    return true;
 }
 
 void save_settings(const char* file_name, Settings* set)
@@ -736,7 +1968,7 @@ void save_settings(const char* file_name, Settings* set)
     g_key_file_free(kf);
 }
 
-void save_mnemonics(const char* file_name, GHashTable* map)
+bool save_mnemonics(const char* file_name, GHashTable* map)
 {
     GKeyFile* kf = g_key_file_new();
     GHashTableIter iter;
@@ -747,10 +1979,25 @@ void save_mnemonics(const char* file_name, GHashTable* map)
         if (a->mnemonic.len > 0) {
             g_key_file_set_string(kf, a->key.str, "mnemonic", a->mnemonic.str);
             g_key_file_set_uint64(kf, a->key.str, "time", (uint64_t)a->time);
+            if (a->launches > 0)
+                g_key_file_set_integer(kf, a->key.str, "count", a->launches);
         }
     }
-    key_file_save(kf, file_name);
+    if (unclaimed)
+        g_hash_table_iter_init(&iter, unclaimed);
+    while (unclaimed && g_hash_table_iter_next(&iter, &key, &value)) {
+        Unclaimed* u = value;
+        if (u->key.len > 0 && u->mnemonic.len > 0) {
+            g_key_file_set_string(kf, u->key.str, "mnemonic", u->mnemonic.str);
+            g_key_file_set_uint64(kf, u->key.str, "time", (uint64_t)u->time);
+            if (u->launches > 0)
+                g_key_file_set_integer(kf, u->key.str, "count", u->launches);
+        }
+    }
+    g_key_file_set_uint64(kf, JOURNAL_GROUP, "generation", usage_journal.generation);
+    bool ok = key_file_save(kf, file_name);
     g_key_file_free(kf);
+    return ok;
 }
 
 void load_mnemonics(const char* file_name, GHashTable* map)
@@ -758,30 +2005,405 @@ void load_mnemonics(const char* file_name, GHashTable* map)
     GKeyFile* kf = g_key_file_new();
     if (g_key_file_load_from_file(kf, file_name, G_KEY_FILE_NONE, NULL)) {
         char** groups = g_key_file_get_groups(kf, NULL);
+        pthread_mutex_lock(&map_mutex);
+        saved_generation = g_key_file_get_uint64(kf, JOURNAL_GROUP, "generation", NULL);
         for (unsigned i = 0; groups[i]; i++) {
+            String key = str_wrap(groups[i]);
             Action* a = g_hash_table_lookup(map, groups[i]);
-            if (!a)
+            Unclaimed* u = NULL;
+            if (!a && !binaries_loaded && str_starts_with(key, STR_S(BINARY_KEY_PREFIX))) {
+                u = get_unclaimed(journal_hash(key)); // PATH is read in the background
+                u->key = str_duplicate(key);
+            } else if (!a) {
                 continue;
-            char* s = g_key_file_get_string(kf, groups[i], "mnemonic", NULL);
-            a->mnemonic = str_own(s);
-            a->time = (time_t)g_key_file_get_uint64(kf, groups[i], "time", NULL);
+            }
+            String mnemonic = str_own(g_key_file_get_string(kf, groups[i], "mnemonic", NULL));
+            time_t time = (time_t)g_key_file_get_uint64(kf, groups[i], "time", NULL);
+            unsigned launches = MAX(0, g_key_file_get_integer(kf, groups[i], "count", NULL));
+            if (a) {
+                a->mnemonic = mnemonic;
+                a->time = time;
+                a->launches = launches;
+            } else {
+                u->mnemonic = mnemonic;
+                u->time = time;
+                u->launches = launches;
+            }
         }
+        request_snapshot();
+        pthread_mutex_unlock(&map_mutex);
+        g_strfreev(groups);
     }
     g_key_file_free(kf);
 }
 
+static void collect_usage(uint64_t key_hash, String mnemonic, int64_t time, void* data)
+{
+    Usage* u = g_hash_table_lookup(data, &key_hash);
+    if (!u) {
+        u = calloc(1, sizeof(Usage));
+        u->key_hash = key_hash;
+        g_hash_table_insert(data, &u->key_hash, u);
+    }
+    memset(u->mnemonic, 0, sizeof(u->mnemonic)); // later launches win
+    memcpy(u->mnemonic, mnemonic.str, mnemonic.len);
+    u->time = (time_t)time;
+    u->count++;
+}
+
+// replay the launches recorded since actions.rc was written, call after load_mnemonics
+// a journal of the generation actions.rc holds is left over from a crash before it was cleared
+static void open_journal(const char* file_name)
+{
+    GHashTable* latest = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, free);
+    journal_open(&usage_journal, file_name, saved_generation + 1, collect_usage, latest);
+    if (g_hash_table_size(latest) > 0) {
+        pthread_mutex_lock(&map_mutex);
+        GHashTableIter iter;
+        gpointer key = NULL, value = NULL;
+        g_hash_table_iter_init(&iter, action_map);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            Action* a = value;
+            uint64_t h = journal_hash(a->key);
+            Usage* u = g_hash_table_lookup(latest, &h);
+            if (!u)
+                continue;
+            str_free(a->mnemonic);
+            a->mnemonic = str_new(u->mnemonic);
+            a->time = u->time;
+            a->launches += u->count; // actions.rc counts the launches before the journal
+            g_hash_table_remove(latest, &h);
+        }
+        // the rest may be binaries, or launchers that are gone
+        g_hash_table_iter_init(&iter, latest);
+        while (!binaries_loaded && g_hash_table_iter_next(&iter, &key, &value)) {
+            Usage* u = value;
+            Unclaimed* c = get_unclaimed(u->key_hash);
+            str_free(c->mnemonic);
+            c->mnemonic = str_new(u->mnemonic);
+            c->time = u->time;
+            c->launches += u->count;
+        }
+        request_snapshot();
+        pthread_mutex_unlock(&map_mutex);
+    }
+    g_hash_table_destroy(latest);
+}
+
+// fold the journal into actions.rc, both under map_mutex so no launch falls in between
+// actions.rc names the journal generation it holds, so a crash before the clear loses nothing
+// and counts nothing twice, binaries only the journal knows wait until PATH was read
+static void compact_journal(void)
+{
+    pthread_mutex_lock(&map_mutex);
+    if (!unclaimed_in_journal() && save_mnemonics(mnemonic_file, action_map))
+        journal_clear(&usage_journal);
+    pthread_mutex_unlock(&map_mutex);
+}
+
+static void* compact_worker(void* data)
+{
+    compact_journal();
+    __atomic_store_n(&compacting, false, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// one small append per launch, map_mutex must be held
+static void record_usage(const Action* a)
+{
+    if (!journal_append(&usage_journal, journal_hash(a->key), a->mnemonic, a->time))
+        return;
+    if (usage_journal.count < JOURNAL_COMPACT_SIZE || __atomic_exchange_n(&compacting, true, __ATOMIC_ACQ_REL))
+        return;
+    pthread_t thread = 0;
+    if (!pthread_create(&thread, NULL, compact_worker, NULL))
+        pthread_detach(thread);
+    else
+        __atomic_store_n(&compacting, false, __ATOMIC_RELEASE);
+}
+
+// populate action_map with the launchers from the index file
+// strings point into the mapped file, so the mapping is kept until exit
+// mnemonics only come from actions.rc and the journal, load_mnemonics adds them
+static bool load_index(const char* file_name)
+{
+    if (!index_open(&launcher_index, file_name))
+        return false;
+    pthread_mutex_lock(&map_mutex);
+    for (uint32_t i = 0; i < launcher_index.count; i++) {
+        IndexEntry e = index_get(&launcher_index, i);
+        if (g_hash_table_contains(action_map, e.key.str))
+            continue;
+        Action* a = arena_alloc(&generation->arena, sizeof(Action));
+        a->key = e.key;
+        a->file_time = (time_t)e.file_time;
+        a->name = e.name;
+        a->exec = e.exec;
+        a->icon = e.icon;
+        a->action = launch_action;
+        a->used = e.used;
+        a->program = e.program;
+        g_hash_table_insert(action_map, a->key.str, a);
+    }
+    request_snapshot();
+    pthread_mutex_unlock(&map_mutex);
+    return true;
+}
+
+static void save_index(const char* file_name)
+{
+    pthread_mutex_lock(&map_mutex);
+    if (!index_dirty) {
+        pthread_mutex_unlock(&map_mutex);
+        return;
+    }
+    IndexEntry* entries = calloc(g_hash_table_size(action_map) + 1, sizeof(IndexEntry));
+    uint32_t count = 0;
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+    g_hash_table_iter_init(&iter, action_map);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        Action* a = value;
+        if (a->action != launch_action || a->file_time == 0)
+            continue;
+        entries[count++] = (IndexEntry) {a->key, a->file_time, a->name, a->exec, a->icon, a->used, a->program};
+    }
+    index_dirty = !index_write(file_name, entries, count);
+    pthread_mutex_unlock(&map_mutex);
+    free(entries);
+}
+
+static String copy_string(Arena* arena, String s)
+{
+    return arena_bytes(s) ? str_arena_duplicate(arena, s) : s;
+}
+
+// copy all launchers into a fresh generation when most of the arena is garbage
+// from reloads, the old generation is then released in one go
+// snapshots have their own copies, so nothing outside action_map points into it
+static void compact_launchers(void)
+{
+    pthread_mutex_lock(&map_mutex);
+    if (generation->garbage < MIN_GARBAGE || generation->garbage * 2 < generation->arena.size) {
+        pthread_mutex_unlock(&map_mutex);
+        return;
+    }
+    Generation* next = new_generation();
+    GPtrArray* launchers = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+    g_hash_table_iter_init(&iter, action_map);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        Action* a = value;
+        if (a->action != launch_action)
+            continue;
+        Action* copy = arena_alloc(&next->arena, sizeof(Action));
+        *copy = *a;
+        copy->key = copy_string(&next->arena, a->key);
+        copy->name = copy_string(&next->arena, a->name);
+        copy->exec = copy_string(&next->arena, a->exec);
+        copy->icon = copy_string(&next->arena, a->icon);
+        copy->mnemonic = copy_string(&next->arena, a->mnemonic); // heap mnemonics move over
+        g_ptr_array_add(launchers, copy);
+        g_hash_table_iter_steal(&iter);
+    }
+    for (unsigned i = 0; i < launchers->len; i++) {
+        Action* a = g_ptr_array_index(launchers, i);
+        g_hash_table_insert(action_map, a->key.str, a);
+    }
+    g_ptr_array_free(launchers, true);
+
+    free_generation(generation);
+    generation = next;
+    pthread_mutex_unlock(&map_mutex);
+}
+
+static void write_latency(const char* file_name)
+{
+    FILE* f = fopen(file_name, "w");
+    if (!f)
+        return;
+    histogram_write(f, latency, STAGE_COUNT);
+    fclose(f);
+    printf("latency histograms written to %s\n", file_name);
+}
+
+static gboolean dump_latency(gpointer data)
+{
+    write_latency(latency_file);
+    return true;
+}
+
+// serialized by update_mutex, the watcher and show_window may start it concurrently
 static void* update_all(void* user_data)
 {
-    read_settings(setting_file, &settings);
+    pthread_mutex_lock(&update_mutex);
+    if (read_settings(setting_file, &settings))
+        invalidate_chrome();
     update_commands();
-    g_hash_table_foreach(action_map, update_launcher, NULL);
-    add_launchers(STR_S(APPLICATIONS_DIR_0));
-    add_launchers(STR_S(APPLICATIONS_DIR_1));
-    add_launchers(STR_S(APPLICATIONS_DIR_2));
-    add_launchers(STR_S(user_app_dir));
+    update_binaries();
+    scan_launchers(launcher_roots, root_count);
+    compact_launchers();
+    save_index(index_file);
+    pthread_mutex_unlock(&update_mutex);
     return NULL;
 }
 
+static void update_all_async(void)
+{
+    pthread_t thread = 0;
+    if (!pthread_create(&thread, NULL, update_all, NULL))
+        pthread_detach(thread);
+}
+
+//------------------------------------------
+// watcher functions
+
+static gboolean save_index_later(gpointer data)
+{
+    save_index(index_file);
+    index_save_source = 0;
+    return false;
+}
+
+static void launcher_changed(String dir, String name, bool removed)
+{
+    if (!str_ends_with_i(name, STR_S(".desktop")))
+        return;
+    String path = str_join_path(dir, name);
+    lock_map();
+    Action* a = g_hash_table_lookup(action_map, path.str);
+    if (a && removed) {
+        a->used = false;
+        a->file_time = 0;
+    } else if (a) {
+        reload_launcher(a);
+    } else if (!removed) {
+        a = new_launcher(path, &generation->arena);
+        g_hash_table_insert(action_map, a->key.str, a);
+    }
+    index_dirty = true;
+    request_snapshot();
+    pthread_mutex_unlock(&map_mutex);
+    str_free(path);
+
+    if (!index_save_source)
+        index_save_source = g_timeout_add_seconds(INDEX_SAVE_DELAY, save_index_later, NULL);
+}
+
+static void config_changed(String name)
+{
+    if (str_equal(name, STR_S(SETTINGS_FILE_NAME)) && read_settings(setting_file, &settings))
+        invalidate_chrome();
+    else if (str_equal(name, STR_S(COMMANDS_FILE_NAME)))
+        update_commands();
+}
+
+static int add_watch(const char* dir)
+{
+    const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE;
+    if (watch_count >= MAX_WATCHES)
+        return -1;
+    int wd = inotify_add_watch(watch_fd, dir, mask);
+    for (unsigned i = 0; i < watch_count && wd >= 0; i++)
+        if (watches[i].wd == wd)
+            return wd; // already watched
+    if (wd >= 0)
+        watches[watch_count++] = (Watch) {wd, str_new(dir)};
+    return wd;
+}
+
+static void remove_watch(int wd)
+{
+    for (unsigned i = 0; i < watch_count; i++) {
+        if (watches[i].wd == wd) {
+            str_free(watches[i].dir);
+            watches[i] = watches[--watch_count];
+            return;
+        }
+    }
+}
+
+// a root that didn't exist can't be watched, show_window scans until the scan finds it
+static bool roots_watched(void)
+{
+    for (unsigned r = 0; r < root_count; r++) {
+        bool found = false;
+        for (unsigned i = 0; i < watch_count && !found; i++)
+            found = !strcmp(watches[i].dir.str, launcher_roots[r]);
+        if (!found)
+            return false;
+    }
+    return true;
+}
+
+// directories the launcher scan found, runs on the gui thread like watch_event
+static gboolean watch_dirs(gpointer data)
+{
+    GPtrArray* dirs = data;
+    for (unsigned i = 0; watching && i < dirs->len; i++)
+        add_watch(g_ptr_array_index(dirs, i));
+    g_ptr_array_free(dirs, true);
+    return false;
+}
+
+static gboolean watch_event(GIOChannel* channel, GIOCondition condition, gpointer data)
+{
+    union {
+        struct inotify_event event;
+        char buffer[4096];
+    } buf;
+    ssize_t len = 0;
+    while ((len = read(watch_fd, buf.buffer, sizeof(buf))) > 0) {
+        for (char* p = buf.buffer; p < buf.buffer + len;) {
+            struct inotify_event* ev = (struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW) {
+                update_all_async(); // lost events, do a full scan
+                continue;
+            }
+            if (ev->mask & IN_IGNORED) {
+                remove_watch(ev->wd); // the directory is gone
+                continue;
+            }
+            if (!ev->len)
+                continue;
+            if (ev->wd != config_wd && (ev->mask & IN_ISDIR)) {
+                update_all_async(); // scan the subdirectory and watch it
+                continue;
+            }
+            if (ev->mask & IN_CREATE)
+                continue; // files are loaded once written
+            String name = str_wrap(ev->name);
+            bool removed = ev->mask & (IN_DELETE | IN_MOVED_FROM);
+            for (unsigned i = 0; i < watch_count; i++) {
+                if (watches[i].wd != ev->wd)
+                    continue;
+                if (!strcmp(watches[i].dir.str, config_dir))
+                    config_changed(name);
+                else
+                    launcher_changed(watches[i].dir, name, removed);
+            }
+        }
+    }
+    return true;
+}
+
+// watch the application and config dirs, returns false if inotify is not available
+static bool init_watcher(void)
+{
+    watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch_fd < 0)
+        return false;
+    for (unsigned i = 0; i < root_count; i++)
+        add_watch(launcher_roots[i]); // subdirectories follow once the scan finds them
+    config_wd = add_watch(config_dir);
+    GIOChannel* channel = g_io_channel_unix_new(watch_fd);
+    g_io_add_watch(channel, G_IO_IN, watch_event, NULL);
+    g_io_channel_unref(channel);
+    return true;
+}
+
 // opens file in an editor and returns immediately
 // the plan was that run_editor only returns after the editor exits.
 // that way I could reload the settings after changes have been made.
@@ -796,7 +2418,7 @@ static void run_editor(const char* file)
 
     signal(SIGCHLD, SIG_DFL); // go back to default child behaviour
     execlp("xdg-open", "", file, (char*)0);
-    execlp("x-terminal-emulator", "", "-e", "editor", file, (char*)0);
+    execlp(terminal, "", DESKTOP_TERMINAL_EXEC_FLAG, "editor", file, (char*)0);
     execlp("xterm", "", "-e", "vi", file, (char*)0); // getting desperate
     printf("failed to open editor for %s\n", file);
     exit(EXIT_FAILURE);
@@ -820,6 +2442,85 @@ static void register_hotkey(const char* binding)
     }
 }
 
+//------------------------------------------
+// remote control
+
+static gboolean ipc_event(GIOChannel* source, GIOCondition condition, gpointer data)
+{
+    int fd;
+    while ((fd = ipc_accept(ipc_fd)) >= 0) {
+        char command[IPC_MAX_MESSAGE], reply[IPC_MAX_MESSAGE] = "ok";
+        if (!ipc_receive(fd, command, sizeof(command))) {
+            close(fd);
+            continue;
+        }
+        if (!strcmp(command, IPC_SHOW)) {
+            show_window();
+        } else if (!strcmp(command, IPC_TOGGLE)) {
+            toggle_window(NULL, NULL);
+        } else if (!strcmp(command, IPC_QUERY)) {
+            // what the list offers, the old snapshot is released on this thread so it stays valid
+            Snapshot* snap = __atomic_load_n(&published, __ATOMIC_ACQUIRE);
+            unsigned count = snap ? snap->corpus.count : 0;
+            snprintf(reply, sizeof(reply), "%s %u", gtk_widget_get_visible(window) ? "visible" : "hidden", count);
+        } else {
+            snprintf(reply, sizeof(reply), "unknown command");
+        }
+        ipc_reply(fd, reply);
+    }
+    return true;
+}
+
+// listen for clients, returns false if another instance already does
+static bool init_remote(void)
+{
+    if (!ipc_socket_path(ipc_path, sizeof(ipc_path)))
+        return false;
+    ipc_fd = ipc_listen(ipc_path);
+    if (ipc_fd < 0) {
+        printf("can't listen on %s, is fehlstart already running?\n", ipc_path);
+        return false;
+    }
+    GIOChannel* channel = g_io_channel_unix_new(ipc_fd);
+    g_io_add_watch(channel, G_IO_IN, ipc_event, NULL);
+    g_io_channel_unref(channel);
+    return true;
+}
+
+static void close_remote(void)
+{
+    if (ipc_fd < 0)
+        return;
+    close(ipc_fd);
+    unlink(ipc_path);
+}
+
+// --show, --toggle or --query, handled before gtk is initialized
+static const char* get_remote_command(int argc, char** argv)
+{
+    const char* command = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--show"))
+            command = IPC_SHOW;
+        else if (!strcmp(argv[i], "--toggle"))
+            command = IPC_TOGGLE;
+        else if (!strcmp(argv[i], "--query"))
+            command = IPC_QUERY;
+    }
+    return command;
+}
+
+// returns true if a running instance handled command
+static bool send_remote_command(const char* command)
+{
+    char path[IPC_PATH_SIZE], reply[IPC_MAX_MESSAGE];
+    if (!ipc_socket_path(path, sizeof(path)) || !ipc_request(path, command, reply, sizeof(reply)))
+        return false;
+    if (!strcmp(command, IPC_QUERY))
+        printf("%s\n", reply);
+    return true;
+}
+
 //------------------------------------------
 // actions
 
@@ -828,30 +2529,82 @@ static void quit_action(String command, Action* action)
     gtk_main_quit();
 }
 
+// the .desktop file is parsed here, the spawn helper only gets the finished argv
 static void launch_action(String command, Action* action)
 {
-    if (fork() != 0)
-        return;
-    setsid();                   // "detatch" from parent process
-    signal(SIGCHLD, SIG_DFL);   // back to default child behaviour
-    GDesktopAppInfo* info = g_desktop_app_info_new_from_filename(action->key.str);
-    if (info != 0)
-        g_app_info_launch(G_APP_INFO(info), NULL, NULL, NULL);
-    g_object_unref(info);
-    exit(EXIT_SUCCESS);
+    String buffer;
+    DesktopEntry entry;
+    char** argv = NULL;
+    if (desktop_load(action->key.str, &buffer, &entry))
+        argv = desktop_exec_argv(&entry, action->key.str);
+    if (!argv || !spawner_request(argv, NULL, entry.path.str))
+        printf("failed to launch %s\n", action->key.str);
+    desktop_free_argv(argv);
+    str_free(buffer);
 }
 
-static void command_action(String command, Action* action)
+static void run_shell_command(String exec, String args)
 {
-    if (fork() != 0)
-        return;
-    setsid();                   // "detatch" from parent process
-    signal(SIGCHLD, SIG_DFL);   // back to default child behaviour
-    unsigned sp = str_find_first(command, STR_S(" ")); // everything after first space is arguments
-    String cmd = str_concat(action->exec, str_substring(command, sp, STR_END));
-    if (system(cmd.str)) {};    // shut up gcc warning
+    String cmd = str_concat(exec, args);
+    char* argv[] = {"/bin/sh", "-c", cmd.str, NULL};
+    if (!spawner_request(argv, NULL, NULL))
+        printf("failed to run %s\n", cmd.str);
     str_free(cmd);
-    exit(EXIT_SUCCESS);
+}
+
+// the typed arguments replace template[args], or are appended if args is negative
+static void run_template(char* const* template, int args, String typed_args, const char* what)
+{
+    char** typed = desktop_split(typed_args);
+    unsigned template_count = 0, typed_count = 0;
+    while (template[template_count])
+        template_count++;
+    while (typed && typed[typed_count])
+        typed_count++;
+
+    char** argv = calloc(template_count + typed_count + 1, sizeof(char*));
+    unsigned n = 0;
+    for (unsigned i = 0; i < template_count; i++) {
+        if ((int)i == args)
+            for (unsigned j = 0; j < typed_count; j++)
+                argv[n++] = typed[j];
+        else
+            argv[n++] = template[i];
+    }
+    for (unsigned j = 0; args < 0 && j < typed_count; j++)
+        argv[n++] = typed[j];
+    if (n == 0 || !spawner_request(argv, NULL, NULL))
+        printf("failed to run %s\n", what);
+    free(argv);
+    desktop_free_argv(typed);
+}
+
+// everything after the first space is arguments, including that space
+static String typed_arguments(String command)
+{
+    unsigned sp = str_find_first(command, STR_S(" "));
+    return sp == STR_END ? STR_S("") : str_substring(command, sp, STR_END);
+}
+
+static void command_action(String command, Action* action)
+{
+    String args = typed_arguments(command);
+    Command* c = action->command;
+    if (!c)
+        return; // Exec was removed, the snapshot hasn't caught up yet
+    if (c->shell)
+        run_shell_command(action->exec, args);
+    else
+        run_template(c->argv, c->args, args, action->exec.str);
+}
+
+// most executables without a .desktop file are console programs, so they get a terminal
+static void binary_action(String command, Action* action)
+{
+    String args = typed_arguments(command);
+    char* in_terminal[] = {terminal, DESKTOP_TERMINAL_EXEC_FLAG, action->exec.str, NULL};
+    char* plain[] = {action->exec.str, NULL};
+    run_template(settings.Path_terminal ? in_terminal : plain, -1, args, action->exec.str);
 }
 
 static void edit_settings_action(String command, Action* action)
@@ -867,7 +2620,9 @@ static void edit_commands_action(String command, Action* action)
         if (!f)
             return;
         fputs("#example: run a command in xterm\n#'run top' will start top in xterm\n"\
-              "#[Run in Terminal]\n#Exec=xterm -e #args are put here\n#Icon=terminal\n", f);
+              "#[Run in Terminal]\n#Exec=xterm -e %a\n#Icon=terminal\n"\
+              "#%a is replaced by the arguments, without it they are appended\n"\
+              "#Exec is run without a shell, add Shell=true for pipes, variables and such\n", f);
         fclose(f);
     }
     run_editor(commands_file);
@@ -881,9 +2636,17 @@ void parse_commandline(int argc, char** argv, Settings* set)
     for (int i = 1; i < argc; i++) {
         if (!strcmp(argv[i], "--one-way")) {
             set->one_time = true;
+        } else if (!strcmp(argv[i], "--daemon")) {
+            set->daemon = true;
+        } else if (!strcmp(argv[i], "--show") || !strcmp(argv[i], "--toggle") || !strcmp(argv[i], "--query")) {
+            // handled by get_remote_command
         } else if (!strcmp(argv[i], "--help")) {
             printf("fehlstart 0.4.0 (c) 2013 maep\noptions:\n"
-                   "\t--one-way\texit after one use\n");
+                   "\t--one-way\texit after one use\n"
+                   "\t--daemon\tdon't grab the hotkey, wait for fehlstart-client\n"
+                   "\t--show\t\tshow the window of the running instance, start one if needed\n"
+                   "\t--toggle\tshow or hide the window of the running instance\n"
+                   "\t--query\t\tprint the state of the running instance\n");
             exit(EXIT_SUCCESS);
         } else {
             printf("invalid option: %s\n", argv[i]);
@@ -927,45 +2690,101 @@ const char* get_desktop_env(void)
     return desktop;
 }
 
+// $TERMINAL, Debian's x-terminal-emulator or xterm, whichever is found first
+static char* find_terminal(void)
+{
+    const char* candidates[] = {getenv("TERMINAL"), "x-terminal-emulator", DESKTOP_TERMINAL};
+    for (unsigned i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        char* path = candidates[i] && candidates[i][0] ? g_find_program_in_path(candidates[i]) : NULL;
+        if (path)
+            return path;
+    }
+    return g_strdup(DESKTOP_TERMINAL);
+}
+
 //------------------------------------------
 // main
 
+#ifndef FEHLSTART_BENCH // bench.c includes this file and brings its own main
 int main(int argc, char** argv)
 {
+    // talk to a running instance before paying for gtk_init
+    const char* command = get_remote_command(argc, argv);
+    if (command && send_remote_command(command))
+        return EXIT_SUCCESS;
+    if (command && !strcmp(command, IPC_QUERY)) {
+        fprintf(stderr, "fehlstart is not running\n");
+        return EXIT_FAILURE;
+    }
+
+    g_chdir(get_home_dir()); // programs start in home, the helper inherits it
+    spawner_start(); // while the process is small and has no threads or x connection
     gtk_init(&argc, &argv);
     parse_commandline(argc, argv, &settings);
 
     signal(SIGCHLD, SIG_IGN); // let kernel raep the children, mwhahaha
-    g_chdir(get_home_dir());
-    g_desktop_app_info_set_desktop_env(get_desktop_env());
+    terminal = find_terminal();
+    desktop_init(get_desktop_env(), g_get_language_names(), terminal);
     user_app_dir = g_build_filename(get_home_dir(), USER_APPLICATIONS_DIR, NULL);
+    launcher_roots[root_count++] = APPLICATIONS_DIR_0;
+    launcher_roots[root_count++] = APPLICATIONS_DIR_1;
+    launcher_roots[root_count++] = user_app_dir;
     action_map = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, free_action);
-    filter_list = g_array_sized_new (false, true, sizeof(Action*), 250);
+    generation = new_generation();
+    filter_list = g_array_sized_new (false, true, sizeof(uint32_t), 250);
+    filter_keys = g_array_sized_new (false, false, sizeof(uint64_t), 250);
 
     add_action("quit fehlstart", "exit", GTK_STOCK_QUIT, quit_action);
     add_action("fehlstart settings", "config preferences", GTK_STOCK_PREFERENCES, edit_settings_action);
     add_action("fehlstart actions", "commands", GTK_STOCK_EXECUTE, edit_commands_action);
 
     // init config files
-    gchar* dir = g_build_filename(g_get_user_config_dir(), "fehlstart", NULL);
+    config_dir = g_build_filename(g_get_user_config_dir(), "fehlstart", NULL);
+    g_mkdir_with_parents(config_dir, 0700);
+    setting_file = g_build_filename(config_dir, SETTINGS_FILE_NAME, NULL);
+    mnemonic_file = g_build_filename(config_dir, MNEMONICS_FILE_NAME, NULL);
+    journal_file = g_build_filename(config_dir, JOURNAL_FILE_NAME, NULL);
+    commands_file = g_build_filename(config_dir, COMMANDS_FILE_NAME, NULL);
+    gchar* dir = g_build_filename(g_get_user_cache_dir(), "fehlstart", NULL);
     g_mkdir_with_parents(dir, 0700);
-    setting_file = g_build_filename(dir, "fehlstart.rc", NULL);
-    mnemonic_file = g_build_filename(dir, "actions.rc", NULL);
-    commands_file = g_build_filename(dir, "commands.rc", NULL);
+    index_file = g_build_filename(dir, INDEX_FILE_NAME, NULL);
+    latency_file = g_build_filename(dir, LATENCY_FILE_NAME, NULL);
     g_free(dir);
 
-    update_all(NULL); // read config and launchers
+    read_settings(setting_file, &settings);
+    watching = init_watcher(); // before the scan so no change slips through
+    update_commands(); // load_mnemonics drops what has no action yet, update_all skips it later
+    bool indexed = load_index(index_file);
+    if (!indexed)
+        update_all(NULL); // read config and launchers
     load_mnemonics(mnemonic_file, action_map);
+    open_journal(journal_file);
+    if (indexed && (watching || !settings.one_time))
+        update_all_async(); // use the index right away, revalidate in background
+    update_snapshot();
+    start_snapshot_thread();
     create_widgets();
-    if (settings.one_time) // one-time use
+    start_prefetcher();
+    if (!settings.one_time)
+        init_remote();
+    if (settings.one_time || command) // one-time use, or nobody answered --show
         show_window();
-    else
+    if (!settings.one_time && !settings.daemon)
         register_hotkey(settings.Bindings_launch);
 
+    g_unix_signal_add(SIGUSR1, dump_latency, NULL); // kill -USR1 writes the histograms
     gtk_main();
 
+    close_remote();
+    spawner_stop();
     save_settings(setting_file, &settings);
-    save_mnemonics(mnemonic_file, action_map);
+    compact_journal();
+    journal_close(&usage_journal);
+    save_index(index_file);
+    write_latency(latency_file);
+#ifdef DEBUG
+    printf("icon cache: %u hits, %u misses\n", icon_cache.hits, icon_cache.misses);
+#endif
     return EXIT_SUCCESS;
 }
-
+#endif
@@ -0,0 +1,191 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "index.h"
+
+// file layout: header, records, string table
+// strings are zero terminated so they can be used as hash keys directly
+
+#define INDEX_MAGIC         "fehlidx"
+#define INDEX_BYTE_ORDER    0x01020304u
+#define FIELD_COUNT         4
+
+enum {FIELD_KEY, FIELD_NAME, FIELD_EXEC, FIELD_ICON};
+
+typedef struct {
+    char        magic[8];
+    uint32_t    byte_order;
+    uint32_t    version;
+    uint32_t    count;
+    uint32_t    strings_size;
+} Header;
+
+typedef struct {
+    int64_t     file_time;
+    uint32_t    offset[FIELD_COUNT];
+    uint32_t    length[FIELD_COUNT];
+    uint32_t    used;
+    uint32_t    program;
+} Record;
+
+static const Header* get_header(const Index* idx)
+{
+    return (const Header*)idx->data;
+}
+
+static const Record* get_records(const Index* idx)
+{
+    return (const Record*)(idx->data + sizeof(Header));
+}
+
+static const char* get_strings(const Index* idx)
+{
+    return idx->data + sizeof(Header) + idx->count * sizeof(Record);
+}
+
+static bool record_valid(const Record* r, const char* strings, uint32_t strings_size)
+{
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        uint64_t end = (uint64_t)r->offset[i] + r->length[i];
+        if (end >= strings_size || strings[end] != 0)
+            return false;
+    }
+    return r->length[FIELD_KEY] > 0;
+}
+
+static bool index_valid(const Index* idx)
+{
+    if (idx->size < sizeof(Header))
+        return false;
+    const Header* h = get_header(idx);
+    if (memcmp(h->magic, INDEX_MAGIC, sizeof(h->magic)) || h->byte_order != INDEX_BYTE_ORDER)
+        return false;
+    if (h->version != INDEX_VERSION)
+        return false;
+    uint64_t size = sizeof(Header) + (uint64_t)h->count * sizeof(Record) + h->strings_size;
+    if (size != idx->size)
+        return false;
+
+    Index tmp = {idx->data, idx->size, h->count};
+    const Record* records = get_records(&tmp);
+    const char* strings = get_strings(&tmp);
+    for (uint32_t i = 0; i < h->count; i++)
+        if (!record_valid(records + i, strings, h->strings_size))
+            return false;
+    return true;
+}
+
+bool index_open(Index* idx, const char* file_name)
+{
+    *idx = (Index) {NULL, 0, 0};
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size < (off_t)sizeof(Header)) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    *idx = (Index) {data, st.st_size, 0};
+    if (!index_valid(idx)) {
+        index_close(idx);
+        return false;
+    }
+    idx->count = get_header(idx)->count;
+    return true;
+}
+
+void index_close(Index* idx)
+{
+    if (idx->data)
+        munmap((void*)idx->data, idx->size);
+    *idx = (Index) {NULL, 0, 0};
+}
+
+IndexEntry index_get(const Index* idx, uint32_t i)
+{
+    const Record* r = get_records(idx) + i;
+    const char* strings = get_strings(idx);
+    #define FIELD(f) str_wrap_n(strings + r->offset[f], r->length[f])
+    IndexEntry e = {
+        .key = FIELD(FIELD_KEY),
+        .file_time = r->file_time,
+        .name = FIELD(FIELD_NAME),
+        .exec = FIELD(FIELD_EXEC),
+        .icon = FIELD(FIELD_ICON),
+        .used = r->used != 0,
+        .program = r->program != 0,
+    };
+    #undef FIELD
+    return e;
+}
+
+//------------------------------------------
+
+static uint32_t add_string(FILE* f, String s, uint32_t* offset)
+{
+    uint32_t pos = *offset;
+    fwrite(s.str, 1, s.len, f);
+    fputc(0, f);
+    *offset += s.len + 1;
+    return pos;
+}
+
+bool index_write(const char* file_name, const IndexEntry* entries, uint32_t count)
+{
+    String tmp_name = str_concat(str_wrap(file_name), STR_S(".tmp"));
+    FILE* f = fopen(tmp_name.str, "wb");
+    if (!f) {
+        str_free(tmp_name);
+        return false;
+    }
+
+    // string table starts with an empty string so empty fields can share it
+    uint32_t strings_size = 1;
+    Record* records = calloc(count ? count : 1, sizeof(Record));
+    fseek(f, sizeof(Header) + count * sizeof(Record), SEEK_SET);
+    fputc(0, f);
+    for (uint32_t i = 0; i < count; i++) {
+        const IndexEntry* e = entries + i;
+        String fields[FIELD_COUNT] = {e->key, e->name, e->exec, e->icon};
+        for (int j = 0; j < FIELD_COUNT; j++) {
+            records[i].length[j] = fields[j].len;
+            records[i].offset[j] = fields[j].len ? add_string(f, fields[j], &strings_size) : 0;
+        }
+        records[i].file_time = e->file_time;
+        records[i].used = e->used;
+        records[i].program = e->program;
+    }
+
+    Header h = {INDEX_MAGIC, INDEX_BYTE_ORDER, INDEX_VERSION, count, strings_size};
+    rewind(f);
+    fwrite(&h, sizeof(h), 1, f);
+    fwrite(records, sizeof(Record), count, f);
+    free(records);
+
+    bool ok = !ferror(f);
+    ok = !fclose(f) && ok;
+    ok = ok && !rename(tmp_name.str, file_name);
+    if (!ok)
+        remove(tmp_name.str);
+    str_free(tmp_name);
+    return ok;
+}
@@ -0,0 +1,48 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <stddef.h>
+#include "str.h"
+
+// bump when the on-disk layout changes, old files are then ignored
+#define INDEX_VERSION 3
+
+typedef struct {
+    String      key;
+    int64_t     file_time;
+    String      name;
+    String      exec;
+    String      icon;
+    bool        used;
+    bool        program;            // the launcher stands for its executable
+} IndexEntry;
+
+typedef struct {
+    const char* data;
+    size_t      size;
+    uint32_t    count;
+} Index;
+
+// map an index file into memory
+// returns false if the file is missing, damaged or has a different version
+bool index_open(Index* idx, const char* file_name);
+
+// unmap the file, strings returned by index_get() become invalid
+void index_close(Index* idx);
+
+// get entry i, strings point into the mapped file and must not be modified
+// freeing them has no effect
+IndexEntry index_get(const Index* idx, uint32_t i);
+
+// write entries to a temporary file and rename it to file_name
+// a mapped old index stays valid
+bool index_write(const char* file_name, const IndexEntry* entries, uint32_t count);
+
+#endif
@@ -0,0 +1,190 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#define _GNU_SOURCE             // struct ucred
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "ipc.h"
+
+#define IPC_TIMEOUT_MS      1000    // a client waiting for the reply
+#define IPC_RECEIVE_MS      100     // the instance waiting for a command, blocks the gui
+
+// /tmp is shared, so the socket goes into a directory only we can enter
+// a directory someone else made, or a symlink, is not used
+static bool private_dir(const char* dir)
+{
+    struct stat st;
+    if (mkdir(dir, 0700) && errno != EEXIST)
+        return false;
+    return !lstat(dir, &st) && S_ISDIR(st.st_mode) && st.st_uid == getuid() && (st.st_mode & 0777) == 0700;
+}
+
+bool ipc_socket_path(char* path, size_t size)
+{
+    const char* runtime = getenv("XDG_RUNTIME_DIR");
+    char dir[IPC_PATH_SIZE];
+    if (runtime && *runtime)
+        snprintf(dir, sizeof(dir), "%s", runtime);
+    else if (snprintf(dir, sizeof(dir), "/tmp/fehlstart-%u", (unsigned)getuid()) <= 0 || !private_dir(dir))
+        return false;
+    int n = snprintf(path, size, "%s/%s", dir, IPC_SOCKET_NAME);
+    return n > 0 && (size_t)n < size && (size_t)n < sizeof(((struct sockaddr_un*)0)->sun_path);
+}
+
+// only connections from our own user are served or trusted
+static bool same_user(int fd)
+{
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    return !getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) && cred.uid == getuid();
+}
+
+static bool make_address(const char* path, struct sockaddr_un* addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path))
+        return false;
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+static void set_timeout(int fd, int ms)
+{
+    struct timeval tv = {ms / 1000, (ms % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+static int new_socket(void)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0)
+        fcntl(fd, F_SETFD, FD_CLOEXEC); // launched programs must not inherit it
+    return fd;
+}
+
+static bool write_all(int fd, const char* data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL); // a vanished peer must not kill us
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// read until newline or end of stream, the newline is removed
+static bool read_line(int fd, char* line, size_t size)
+{
+    size_t len = 0;
+    while (len + 1 < size) {
+        ssize_t n = read(fd, line + len, size - len - 1);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        len += n;
+        if (memchr(line + len - n, '\n', n))
+            break;
+    }
+    line[len] = 0;
+    char* eol = strchr(line, '\n');
+    if (eol)
+        *eol = 0;
+    return len > 0;
+}
+
+int ipc_listen(const char* path)
+{
+    struct sockaddr_un addr;
+    if (!make_address(path, &addr))
+        return -1;
+    int fd = new_socket();
+    if (fd < 0)
+        return -1;
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr))) {
+        if (errno != EADDRINUSE) { // path is not ours to chmod or listen on
+            close(fd);
+            return -1;
+        }
+        // only remove the socket if nobody answers on it
+        int probe = new_socket();
+        bool alive = probe >= 0 && !connect(probe, (struct sockaddr*)&addr, sizeof(addr));
+        if (probe >= 0)
+            close(probe);
+        if (alive || unlink(path) || bind(fd, (struct sockaddr*)&addr, sizeof(addr))) {
+            close(fd);
+            return -1;
+        }
+    }
+    if (chmod(path, 0600) || listen(fd, 4)) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+int ipc_accept(int listen_fd)
+{
+    int fd;
+    while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        if (same_user(fd))
+            break;
+        close(fd); // another user, don't even answer
+    }
+    if (fd >= 0)
+        set_timeout(fd, IPC_RECEIVE_MS);
+    return fd;
+}
+
+bool ipc_receive(int fd, char* command, size_t size)
+{
+    return read_line(fd, command, size);
+}
+
+void ipc_reply(int fd, const char* reply)
+{
+    write_all(fd, reply, strlen(reply));
+    write_all(fd, "\n", 1);
+    close(fd);
+}
+
+bool ipc_request(const char* path, const char* command, char* reply, size_t size)
+{
+    struct sockaddr_un addr;
+    if (!make_address(path, &addr))
+        return false;
+    int fd = new_socket();
+    if (fd < 0)
+        return false;
+    set_timeout(fd, IPC_TIMEOUT_MS);
+    bool ok = !connect(fd, (struct sockaddr*)&addr, sizeof(addr))
+        && same_user(fd)
+        && write_all(fd, command, strlen(command))
+        && write_all(fd, "\n", 1)
+        && !shutdown(fd, SHUT_WR)
+        && read_line(fd, reply, size);
+    close(fd);
+    return ok;
+}
@@ -0,0 +1,49 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#ifndef IPC_H
+#define IPC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// a running instance listens on a unix socket, clients send one command
+// line, the instance answers with one line and closes the connection
+
+#define IPC_SOCKET_NAME     "fehlstart.sock"
+#define IPC_MAX_MESSAGE     64
+#define IPC_PATH_SIZE       108     // sun_path on linux
+
+#define IPC_SHOW            "show"
+#define IPC_TOGGLE          "toggle"
+#define IPC_QUERY           "query"
+
+// $XDG_RUNTIME_DIR/fehlstart.sock or /tmp/fehlstart-<uid>/fehlstart.sock
+// the /tmp directory is created with mode 0700 and has to be ours
+// returns false if the path doesn't fit into size or the directory can't be trusted
+bool ipc_socket_path(char* path, size_t size);
+
+// bind and listen on path with mode 0600, a stale socket left by a crashed instance is replaced
+// returns -1 if another instance is listening or on error
+int ipc_listen(const char* path);
+
+// accept a pending connection from the same user, others are closed right away
+// returns -1 if there is none
+int ipc_accept(int listen_fd);
+
+// read one command from an accepted connection
+// returns false if the client sent nothing in time
+bool ipc_receive(int fd, char* command, size_t size);
+
+// answer the command and close the connection
+void ipc_reply(int fd, const char* reply);
+
+// send command to the running instance and wait for the reply line
+// returns false if no instance of the same user is listening
+bool ipc_request(const char* path, const char* command, char* reply, size_t size);
+
+#endif
@@ -0,0 +1,170 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "journal.h"
+
+// file layout: header, then records until the end of the file
+// records are small enough for O_APPEND writes to land in one piece
+
+#define JOURNAL_MAGIC       "fehljnl"
+#define JOURNAL_BYTE_ORDER  0x01020304u
+#define FNV_OFFSET          0xcbf29ce484222325ull
+#define FNV_PRIME           0x100000001b3ull
+
+typedef struct {
+    char        magic[8];
+    uint32_t    byte_order;
+    uint32_t    version;
+    uint64_t    generation;
+} Header;
+
+typedef struct {
+    uint64_t    key_hash;
+    int64_t     time;
+    uint32_t    check;              // hash of the record with check set to 0
+    uint8_t     mnemonic_len;
+    char        mnemonic[JOURNAL_MNEMONIC_SIZE];
+} Record;
+
+static uint64_t fnv1a(const void* data, size_t len)
+{
+    const unsigned char* p = data;
+    uint64_t h = FNV_OFFSET;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ p[i]) * FNV_PRIME;
+    return h;
+}
+
+uint64_t journal_hash(String key)
+{
+    return fnv1a(key.str, key.len);
+}
+
+static uint32_t record_check(Record r)
+{
+    r.check = 0;
+    return (uint32_t)fnv1a(&r, sizeof(r));
+}
+
+static bool record_valid(const Record* r)
+{
+    return r->mnemonic_len <= JOURNAL_MNEMONIC_SIZE && r->check == record_check(*r);
+}
+
+static bool write_all(int fd, const void* data, size_t len)
+{
+    ssize_t n;
+    do
+        n = write(fd, data, len);
+    while (n < 0 && errno == EINTR);
+    return n == (ssize_t)len;
+}
+
+// returns the size of the valid part, 0 if the header is bad or the generation too old
+static off_t replay(Journal* j, int fd, uint64_t first_generation, JournalVisit visit, void* data)
+{
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size < (off_t)sizeof(Header))
+        return 0;
+    char* buffer = malloc(st.st_size);
+    if (!buffer)
+        return 0;
+    ssize_t size = pread(fd, buffer, st.st_size, 0);
+    const Header* h = (const Header*)buffer;
+    if (size < (ssize_t)sizeof(Header) || memcmp(h->magic, JOURNAL_MAGIC, sizeof(h->magic))
+        || h->byte_order != JOURNAL_BYTE_ORDER || h->version != JOURNAL_VERSION
+        || h->generation < first_generation) {
+        free(buffer);
+        return 0;
+    }
+    j->generation = h->generation;
+    off_t valid = sizeof(Header);
+    while (valid + (off_t)sizeof(Record) <= size) {
+        Record r;
+        memcpy(&r, buffer + valid, sizeof(r));
+        if (!record_valid(&r))
+            break;
+        visit(r.key_hash, str_wrap_n(r.mnemonic, r.mnemonic_len), r.time, data);
+        valid += sizeof(Record);
+        j->count++;
+    }
+    free(buffer);
+    return valid;
+}
+
+// the file must be empty, with O_APPEND the header lands at the start
+static bool write_header(int fd, uint64_t generation)
+{
+    Header h = {JOURNAL_MAGIC, JOURNAL_BYTE_ORDER, JOURNAL_VERSION, generation};
+    return write_all(fd, &h, sizeof(h));
+}
+
+bool journal_open(Journal* j, const char* file_name, uint64_t first_generation, JournalVisit visit, void* data)
+{
+    *j = (Journal) {-1, 0, first_generation};
+    int fd = open(file_name, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return false;
+    // a torn or damaged tail is cut off so new records follow the last good one
+    off_t valid = replay(j, fd, first_generation, visit, data);
+    if (ftruncate(fd, valid) || (valid == 0 && !write_header(fd, first_generation))) {
+        close(fd);
+        *j = (Journal) {-1, 0, first_generation};
+        return false;
+    }
+    j->fd = fd;
+    return true;
+}
+
+void journal_close(Journal* j)
+{
+    if (j->fd >= 0)
+        close(j->fd);
+    *j = (Journal) {-1, 0, j->generation};
+}
+
+bool journal_append(Journal* j, uint64_t key_hash, String mnemonic, int64_t time)
+{
+    if (j->fd < 0)
+        return false;
+    Record r;
+    memset(&r, 0, sizeof(r));
+    r.key_hash = key_hash;
+    r.time = time;
+    r.mnemonic_len = mnemonic.len < JOURNAL_MNEMONIC_SIZE ? mnemonic.len : JOURNAL_MNEMONIC_SIZE;
+    memcpy(r.mnemonic, mnemonic.str, r.mnemonic_len);
+    r.check = record_check(r);
+    if (!write_all(j->fd, &r, sizeof(r))) {
+        // a partial record would hide all later ones from replay
+        if (ftruncate(j->fd, sizeof(Header) + (off_t)j->count * sizeof(Record))) {};
+        return false;
+    }
+    j->count++;
+    return true;
+}
+
+bool journal_clear(Journal* j)
+{
+    if (j->fd < 0)
+        return false;
+    // a crash in between leaves an empty file, journal_open starts it at the saved generation + 1
+    if (ftruncate(j->fd, 0) || !write_header(j->fd, j->generation + 1)) {
+        journal_close(j);
+        return false;
+    }
+    j->generation++;
+    j->count = 0;
+    return true;
+}
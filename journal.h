@@ -0,0 +1,51 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+#include "str.h"
+
+// append-only log of launches, one fixed size record per launch
+// a torn or damaged record at the end is dropped when the journal is opened
+// each clear starts a new generation, whoever saves the records elsewhere stores
+// the generation with them so a crash before the clear doesn't count them twice
+
+// bump when the record layout changes, old journals are then discarded
+#define JOURNAL_VERSION         2
+#define JOURNAL_MNEMONIC_SIZE   19  // longer mnemonics are cut
+
+typedef struct {
+    int         fd;
+    uint32_t    count;              // records in the file
+    uint64_t    generation;         // incremented by journal_clear()
+} Journal;
+
+// called for every record in file order, later records win
+typedef void (*JournalVisit)(uint64_t key_hash, String mnemonic, int64_t time, void* data);
+
+// hash of an action key as stored in the records
+uint64_t journal_hash(String key);
+
+// open or create file_name for appending and replay its records
+// a journal older than first_generation was saved already, it is cleared unread
+// and continues at first_generation
+// returns false if the file can't be opened, appends then fail
+bool journal_open(Journal* j, const char* file_name, uint64_t first_generation, JournalVisit visit, void* data);
+
+void journal_close(Journal* j);
+
+// append one record with a single write
+bool journal_append(Journal* j, uint64_t key_hash, String mnemonic, int64_t time);
+
+// drop all records and start the next generation, call once the records
+// were saved elsewhere together with their generation
+// the journal is closed if that fails, later records would count as saved
+bool journal_clear(Journal* j);
+
+#endif
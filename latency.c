@@ -0,0 +1,93 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "latency.h"
+
+#define SUB_COUNT   (1u << LATENCY_SUB_BITS)
+
+uint64_t latency_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// values below SUB_COUNT get their own bucket, above that the top
+// LATENCY_SUB_BITS + 1 bits select the bucket
+static unsigned bucket_index(uint64_t ns)
+{
+    if (ns < SUB_COUNT)
+        return ns;
+    unsigned log = 63 - __builtin_clzll(ns);
+    unsigned sub = (ns >> (log - LATENCY_SUB_BITS)) & (SUB_COUNT - 1);
+    return (log - LATENCY_SUB_BITS + 1) * SUB_COUNT + sub;
+}
+
+// smallest value that falls into bucket i
+static uint64_t bucket_low(unsigned i)
+{
+    if (i < SUB_COUNT)
+        return i;
+    unsigned log = i / SUB_COUNT + LATENCY_SUB_BITS - 1;
+    return (uint64_t)(SUB_COUNT + i % SUB_COUNT) << (log - LATENCY_SUB_BITS);
+}
+
+void histogram_add(Histogram* h, uint64_t ns)
+{
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->buckets[bucket_index(ns)], 1, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    while (ns > max && !__atomic_compare_exchange_n(&h->max, &max, ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+uint64_t histogram_since(Histogram* h, uint64_t begin)
+{
+    uint64_t now = latency_now();
+    histogram_add(h, now - begin);
+    return now;
+}
+
+// upper bound of the bucket that holds the p-th percentile
+static uint64_t percentile(const Histogram* h, uint64_t count, double p)
+{
+    uint64_t rank = (uint64_t)(count * p / 100.0 + 0.5);
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank && seen > 0 && i + 1 < LATENCY_BUCKETS && bucket_low(i + 1) <= h->max)
+            return bucket_low(i + 1) - 1;
+        if (seen >= rank && seen > 0)
+            return h->max;
+    }
+    return h->max;
+}
+
+void histogram_write(FILE* f, const Histogram* histograms, unsigned count)
+{
+    fprintf(f, "# times in us, percentiles are bucket upper bounds\n");
+    fprintf(f, "# %-14s %10s %10s %10s %10s %10s %10s\n", "stage", "count", "mean", "p50", "p90", "p99", "max");
+    for (unsigned i = 0; i < count; i++) {
+        // copy so the numbers agree with each other while other threads add samples
+        Histogram h;
+        memcpy(&h, histograms + i, sizeof(h));
+        double mean = h.count ? h.sum / 1000.0 / h.count : 0;
+        fprintf(f, "%-16s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", h.name, (unsigned long long)h.count,
+                mean, percentile(&h, h.count, 50) / 1000.0, percentile(&h, h.count, 90) / 1000.0,
+                percentile(&h, h.count, 99) / 1000.0, h.max / 1000.0);
+    }
+    fprintf(f, "\n# buckets: stage, lower bound in us, count\n");
+    for (unsigned i = 0; i < count; i++)
+        for (unsigned b = 0; b < LATENCY_BUCKETS; b++)
+            if (histograms[i].buckets[b])
+                fprintf(f, "%s %.3f %u\n", histograms[i].name, bucket_low(b) / 1000.0, histograms[i].buckets[b]);
+}
@@ -0,0 +1,38 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// log scaled histogram, 4 buckets per power of two, about 19% resolution
+#define LATENCY_SUB_BITS    2
+#define LATENCY_BUCKETS     (64 << LATENCY_SUB_BITS)
+
+// counters are updated atomically, any thread may add samples
+typedef struct {
+    const char* name;
+    uint64_t    count;
+    uint64_t    sum;                // ns
+    uint64_t    max;                // ns
+    uint32_t    buckets[LATENCY_BUCKETS];
+} Histogram;
+
+// monotonic clock in ns
+uint64_t latency_now(void);
+
+void histogram_add(Histogram* h, uint64_t ns);
+
+// add the time since begin, returns the current time so stages can be chained
+uint64_t histogram_since(Histogram* h, uint64_t begin);
+
+// write count, mean, percentiles and the non-empty buckets of each histogram
+void histogram_write(FILE* f, const Histogram* histograms, unsigned count);
+
+#endif
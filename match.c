@@ -0,0 +1,104 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#include <string.h>
+#include "match.h"
+
+// score weights, see fuzzy_score()
+#define SCORE_MATCH         16
+#define BONUS_BOUNDARY      8       // character starts a word
+#define BONUS_CONSECUTIVE   4       // character follows the previous match
+#define PENALTY_GAP_START   3
+#define PENALTY_GAP_EXTEND  1
+
+inline static char fold(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+inline static bool is_separator(char c)
+{
+    return c == ' ' || c == '-' || c == '_' || c == '.' || c == '/' || c == ':';
+}
+
+// the corpus is lowercase, so only separators start words
+static bool is_word_start(String s, uint32_t i)
+{
+    return i == 0 || is_separator(s.str[i - 1]);
+}
+
+void fuzzy_compile(FuzzyPattern* p, String query)
+{
+    memset(p->masks, 0, sizeof(p->masks));
+    p->len = query.len < FUZZY_MAX_QUERY ? query.len : FUZZY_MAX_QUERY;
+    for (uint32_t j = 0; j < p->len; j++) {
+        char c = fold(query.str[j]);
+        p->query[j] = c;
+        p->masks[(unsigned char)c] |= 1ull << j;
+        if (c >= 'a' && c <= 'z')
+            p->masks[(unsigned char)(c - ('a' - 'A'))] |= 1ull << j;
+    }
+}
+
+// bit j of state is set when query[0..j] is a subsequence of what was seen so far
+bool fuzzy_match(const FuzzyPattern* p, String s)
+{
+    if (p->len == 0)
+        return false;
+    const uint64_t goal = 1ull << (p->len - 1);
+    uint64_t state = 0;
+    for (uint32_t i = 0; i < s.len; i++) {
+        state |= ((state << 1) | 1) & p->masks[(unsigned char)s.str[i]];
+        if (state & goal)
+            return true;
+    }
+    return false;
+}
+
+// the shortest window ending at the first complete match is scored,
+// found by a forward and a backward greedy pass
+int fuzzy_score(const FuzzyPattern* p, String s)
+{
+    if (!fuzzy_match(p, s))
+        return 0;
+
+    uint32_t j = 0, end = 0, start = 0;
+    for (uint32_t i = 0; i < s.len; i++) {
+        if (fold(s.str[i]) == p->query[j] && ++j == p->len) {
+            end = i;
+            break;
+        }
+    }
+    for (uint32_t i = end + 1; i-- > 0;) {
+        if (fold(s.str[i]) == p->query[j - 1] && --j == 0) {
+            start = i;
+            break;
+        }
+    }
+
+    int score = 0;
+    bool matched_prev = false, in_gap = false;
+    for (uint32_t i = start; i <= end && j < p->len; i++) {
+        if (fold(s.str[i]) != p->query[j]) {
+            score -= in_gap ? PENALTY_GAP_EXTEND : PENALTY_GAP_START;
+            in_gap = true;
+            matched_prev = false;
+            continue;
+        }
+        score += SCORE_MATCH;
+        score += is_word_start(s, i) ? BONUS_BOUNDARY : 0;
+        score += matched_prev ? BONUS_CONSECUTIVE : 0;
+        matched_prev = true;
+        in_gap = false;
+        j++;
+    }
+
+    // a prefix match scores best
+    int best = p->len * (SCORE_MATCH + BONUS_CONSECUTIVE) + BONUS_BOUNDARY - BONUS_CONSECUTIVE;
+    int quality = score * 100 / best;
+    return quality < 1 ? 1 : quality > 100 ? 100 : quality;
+}
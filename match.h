@@ -0,0 +1,33 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#ifndef MATCH_H
+#define MATCH_H
+
+#include "str.h"
+
+// fuzzy matching: the query has to appear as a subsequence, "ffx" matches "firefox"
+
+#define FUZZY_MAX_QUERY 64
+
+typedef struct {
+    uint64_t    masks[256];         // bit j is set if query[j] matches the byte, any case
+    char        query[FUZZY_MAX_QUERY];
+    uint32_t    len;
+} FuzzyPattern;
+
+// prepare a query, longer queries are truncated to FUZZY_MAX_QUERY
+void fuzzy_compile(FuzzyPattern* p, String query);
+
+// true if the pattern is a subsequence of s, not case sensitive
+bool fuzzy_match(const FuzzyPattern* p, String s);
+
+// rates how well the pattern matches s, from 1 (scattered) to 100 (consecutive
+// characters at word starts), 0 means no match
+int fuzzy_score(const FuzzyPattern* p, String s);
+
+#endif
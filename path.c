@@ -0,0 +1,192 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE         // d_type
+
+#include <string.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "path.h"
+
+struct PathDir {
+    char*       path;
+    struct timespec mtime;          // of the directory when names was read
+    bool        exists;
+    char**      names;              // executables
+    uint32_t    count;
+};
+
+static void free_dir(PathDir* d)
+{
+    for (uint32_t i = 0; i < d->count; i++)
+        free(d->names[i]);
+    free(d->names);
+    free(d->path);
+    memset(d, 0, sizeof(PathDir));
+}
+
+static bool is_executable(int dir_fd, const char* name)
+{
+    struct stat st;
+    return !fstatat(dir_fd, name, &st, 0) && S_ISREG(st.st_mode) && (st.st_mode & 0111);
+}
+
+// read the executables of d, one stat per file, only done when the directory changed
+static void read_dir(PathDir* d)
+{
+    for (uint32_t i = 0; i < d->count; i++)
+        free(d->names[i]);
+    d->count = 0;
+    DIR* dir = opendir(d->path);
+    if (!dir)
+        return;
+    uint32_t cap = 0;
+    struct dirent* ent;
+    while ((ent = readdir(dir))) {
+        if (ent->d_name[0] == '.')
+            continue;
+        if (ent->d_type != DT_REG && ent->d_type != DT_LNK && ent->d_type != DT_UNKNOWN)
+            continue;
+        if (!is_executable(dirfd(dir), ent->d_name))
+            continue;
+        if (d->count == cap) {
+            cap = cap ? cap * 2 : 256;
+            d->names = realloc(d->names, cap * sizeof(char*));
+        }
+        d->names[d->count++] = strdup(ent->d_name);
+    }
+    closedir(dir);
+}
+
+// returns true if the listing of d was read again
+static bool update_dir(PathDir* d)
+{
+    struct stat st;
+    bool exists = !stat(d->path, &st) && S_ISDIR(st.st_mode);
+    if (!exists) {
+        bool changed = d->exists;
+        d->exists = false;
+        return changed;
+    }
+    if (d->exists && st.st_mtim.tv_sec == d->mtime.tv_sec && st.st_mtim.tv_nsec == d->mtime.tv_nsec)
+        return false;
+    d->exists = true;
+    d->mtime = st.st_mtim;
+    read_dir(d);
+    return true;
+}
+
+static PathDir* find_dir(PathCache* cache, const char* path, size_t len)
+{
+    for (uint32_t i = 0; i < cache->dir_count; i++) {
+        PathDir* d = cache->dirs + i;
+        if (d->path && strlen(d->path) == len && !strncmp(d->path, path, len))
+            return d;
+    }
+    return NULL;
+}
+
+// move the directories of path to the front of cache->dirs in PATH order, drop the rest
+// returns true if the list of directories changed
+static bool update_dirs(PathCache* cache, const char* path)
+{
+    uint32_t cap = 1;
+    for (const char* p = path; *p; p++)
+        cap += *p == ':';
+    PathDir* dirs = calloc(cap, sizeof(PathDir));
+    uint32_t count = 0;
+    bool changed = false;
+    for (const char* p = path; *p;) {
+        const char* end = strchr(p, ':');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len > 0 && p[0] == '/') {
+            bool duplicate = false;
+            for (uint32_t i = 0; i < count && !duplicate; i++)
+                duplicate = strlen(dirs[i].path) == len && !strncmp(dirs[i].path, p, len);
+            PathDir* old = duplicate ? NULL : find_dir(cache, p, len);
+            if (old) {
+                dirs[count] = *old;
+                memset(old, 0, sizeof(PathDir)); // moved
+            } else if (!duplicate) {
+                dirs[count].path = strndup(p, len);
+            }
+            if (!duplicate) {
+                changed |= !old || old != cache->dirs + count;
+                count++;
+            }
+        }
+        p += len + (end != NULL);
+    }
+    for (uint32_t i = 0; i < cache->dir_count; i++) {
+        changed |= cache->dirs[i].path != NULL; // a directory left PATH
+        free_dir(cache->dirs + i);
+    }
+    free(cache->dirs);
+    cache->dirs = dirs;
+    cache->dir_count = count;
+    return changed;
+}
+
+typedef struct {
+    const char*     name;
+    const PathDir*  dir;            // dirs are in PATH order, so are the pointers
+} Candidate;
+
+static int compare_candidates(const void* a, const void* b)
+{
+    const Candidate* c1 = a;
+    const Candidate* c2 = b;
+    int c = strcmp(c1->name, c2->name);
+    return c ? c : (c1->dir > c2->dir) - (c1->dir < c2->dir);
+}
+
+// merge all listings, for names in several directories the one first in PATH wins
+static void merge_entries(PathCache* cache)
+{
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < cache->dir_count; i++)
+        total += cache->dirs[i].exists ? cache->dirs[i].count : 0;
+    Candidate* candidates = malloc((total ? total : 1) * sizeof(Candidate));
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < cache->dir_count; i++) {
+        const PathDir* d = cache->dirs + i;
+        for (uint32_t j = 0; d->exists && j < d->count; j++)
+            candidates[n++] = (Candidate) {d->names[j], d};
+    }
+    qsort(candidates, n, sizeof(Candidate), compare_candidates);
+
+    free(cache->entries);
+    cache->entries = malloc((n ? n : 1) * sizeof(PathEntry));
+    cache->count = 0;
+    for (uint32_t i = 0; i < n; i++)
+        if (i == 0 || strcmp(candidates[i - 1].name, candidates[i].name)) // the rest is shadowed
+            cache->entries[cache->count++] = (PathEntry) {candidates[i].name, candidates[i].dir->path};
+    free(candidates);
+}
+
+bool path_update(PathCache* cache, const char* path)
+{
+    bool changed = update_dirs(cache, path ? path : "");
+    for (uint32_t i = 0; i < cache->dir_count; i++)
+        changed |= update_dir(cache->dirs + i);
+    if (changed)
+        merge_entries(cache);
+    return changed;
+}
+
+void path_free(PathCache* cache)
+{
+    for (uint32_t i = 0; i < cache->dir_count; i++)
+        free_dir(cache->dirs + i);
+    free(cache->dirs);
+    free(cache->entries);
+    memset(cache, 0, sizeof(PathCache));
+}
@@ -0,0 +1,38 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#ifndef PATH_H
+#define PATH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// executables in $PATH, each directory's listing is kept until its mtime changes
+// so a rescan of an unchanged PATH costs one stat per entry
+
+typedef struct PathDir PathDir;
+
+typedef struct {
+    const char* name;
+    const char* dir;                // first PATH entry that has name
+} PathEntry;
+
+typedef struct {
+    PathDir*    dirs;
+    uint32_t    dir_count;
+    PathEntry*  entries;            // sorted by name, shadowed names are left out
+    uint32_t    count;
+} PathCache;
+
+// rescan the directories of path, a : separated list like $PATH
+// relative entries are ignored, returns true if entries changed
+// entries stay valid until the next call that returns true
+bool path_update(PathCache* cache, const char* path);
+
+void path_free(PathCache* cache);
+
+#endif
@@ -0,0 +1,334 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE         // d_type constants, syscall
+
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "scan.h"
+
+#define DENTS_BUFFER_SIZE   32768
+
+// record layout of getdents64, glibc only has a wrapper since 2.30
+typedef struct {
+    uint64_t        ino;
+    int64_t         off;
+    unsigned short  reclen;
+    unsigned char   type;
+    char            name[];
+} Dirent64;
+
+typedef struct {
+    char*       name;
+    time_t      mtime;
+} ScanFile;
+
+struct ScanDir {
+    char*           path;
+    const char*     name;           // last component of path
+    struct timespec mtime;          // of the directory when files and dirs were read
+    bool            exists;
+    ScanFile*       files;          // sorted by name
+    uint32_t        file_count;
+    ScanDir**       dirs;           // sorted by name
+    uint32_t        dir_count;
+};
+
+// directories seen in this scan, a symlink loop or a second link to a tree is skipped
+typedef struct {
+    struct {
+        dev_t   dev;
+        ino_t   ino;
+    }*          ids;
+    uint32_t    count;
+    uint32_t    cap;
+} Visited;
+
+// what read_listing found, becomes the new state of the directory
+typedef struct {
+    ScanFile*   files;
+    uint32_t    file_count;
+    uint32_t    file_cap;
+    char**      dirs;
+    uint32_t    dir_count;
+    uint32_t    dir_cap;
+} Listing;
+
+static char* join_path(const char* dir, const char* name)
+{
+    size_t dir_len = strlen(dir), name_len = strlen(name);
+    char* path = malloc(dir_len + name_len + 2);
+    memcpy(path, dir, dir_len);
+    path[dir_len] = '/';
+    memcpy(path + dir_len + 1, name, name_len + 1);
+    return path;
+}
+
+static ScanDir* new_dir(char* path)
+{
+    ScanDir* d = calloc(1, sizeof(ScanDir));
+    d->path = path;
+    const char* slash = strrchr(path, '/');
+    d->name = slash ? slash + 1 : path;
+    return d;
+}
+
+static void free_dir(ScanDir* d);
+
+static void clear_dir(ScanDir* d)
+{
+    for (uint32_t i = 0; i < d->file_count; i++)
+        free(d->files[i].name);
+    free(d->files);
+    for (uint32_t i = 0; i < d->dir_count; i++)
+        free_dir(d->dirs[i]);
+    free(d->dirs);
+    d->files = NULL;
+    d->dirs = NULL;
+    d->file_count = d->dir_count = 0;
+}
+
+static void free_dir(ScanDir* d)
+{
+    clear_dir(d);
+    free(d->path);
+    free(d);
+}
+
+static void visit_file(const ScanDir* d, const char* name, ScanEvent event, time_t mtime, ScanVisit visit, void* data)
+{
+    char* path = join_path(d->path, name);
+    visit(event, path, mtime, data);
+    free(path);
+}
+
+// everything below d is gone
+static void report_removed(const ScanDir* d, ScanVisit visit, void* data)
+{
+    for (uint32_t i = 0; i < d->file_count; i++)
+        visit_file(d, d->files[i].name, SCAN_REMOVED, 0, visit, data);
+    for (uint32_t i = 0; i < d->dir_count; i++)
+        report_removed(d->dirs[i], visit, data);
+}
+
+static bool has_suffix(const char* name, const char* suffix)
+{
+    size_t len = strlen(name), suffix_len = strlen(suffix);
+    return len >= suffix_len && !strcasecmp(name + len - suffix_len, suffix);
+}
+
+static void add_file(Listing* l, const char* name, time_t mtime)
+{
+    if (l->file_count == l->file_cap) {
+        l->file_cap = l->file_cap ? l->file_cap * 2 : 64;
+        l->files = realloc(l->files, l->file_cap * sizeof(ScanFile));
+    }
+    l->files[l->file_count++] = (ScanFile) {strdup(name), mtime};
+}
+
+static void add_dir(Listing* l, const char* name)
+{
+    if (l->dir_count == l->dir_cap) {
+        l->dir_cap = l->dir_cap ? l->dir_cap * 2 : 8;
+        l->dirs = realloc(l->dirs, l->dir_cap * sizeof(char*));
+    }
+    l->dirs[l->dir_count++] = strdup(name);
+}
+
+// read the directory in bulk, entries are stat'ed relative to it and only if
+// they could be a wanted file or a symlinked directory, returns false on error
+static bool read_listing(int fd, const char* suffix, bool recurse, Listing* l)
+{
+    uint64_t buffer[DENTS_BUFFER_SIZE / sizeof(uint64_t)]; // records are 8 byte aligned
+    long n = 0;
+    while ((n = syscall(SYS_getdents64, fd, buffer, sizeof(buffer))) > 0) {
+        for (long pos = 0; pos < n;) {
+            const Dirent64* e = (const Dirent64*)((const char*)buffer + pos);
+            pos += e->reclen;
+            const char* name = e->name;
+            if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+                continue;
+            if (e->type == DT_DIR) {
+                if (recurse)
+                    add_dir(l, name);
+                continue;
+            }
+            bool wanted = has_suffix(name, suffix);
+            if (e->type == DT_REG ? !wanted : e->type != DT_LNK && e->type != DT_UNKNOWN)
+                continue;
+            struct stat st;
+            if (fstatat(fd, name, &st, 0))
+                continue; // dangling symlink, or removed while reading
+            if (S_ISDIR(st.st_mode) && recurse)
+                add_dir(l, name);
+            else if (S_ISREG(st.st_mode) && wanted)
+                add_file(l, name, st.st_mtime);
+        }
+    }
+    return n == 0;
+}
+
+static int compare_files(const void* a, const void* b)
+{
+    return strcmp(((const ScanFile*)a)->name, ((const ScanFile*)b)->name);
+}
+
+static int compare_names(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// report the differences between the old files of d and l, then take over l's
+static void merge_files(ScanDir* d, Listing* l, ScanVisit visit, void* data)
+{
+    if (l->file_count)
+        qsort(l->files, l->file_count, sizeof(ScanFile), compare_files);
+    uint32_t i = 0, j = 0;
+    while (i < d->file_count || j < l->file_count) {
+        int c = i == d->file_count ? 1 : j == l->file_count ? -1 : strcmp(d->files[i].name, l->files[j].name);
+        if (c < 0)
+            visit_file(d, d->files[i].name, SCAN_REMOVED, 0, visit, data);
+        else if (c > 0 || d->files[i].mtime != l->files[j].mtime)
+            visit_file(d, l->files[j].name, SCAN_FILE, l->files[j].mtime, visit, data);
+        if (c <= 0)
+            free(d->files[i++].name);
+        if (c >= 0)
+            j++;
+    }
+    free(d->files);
+    d->files = l->files;
+    d->file_count = l->file_count;
+}
+
+// keep the subdirectories that are still there with their state, the new ones get read below
+static void merge_dirs(ScanDir* d, Listing* l, ScanVisit visit, void* data)
+{
+    if (l->dir_count)
+        qsort(l->dirs, l->dir_count, sizeof(char*), compare_names);
+    ScanDir** dirs = malloc((l->dir_count ? l->dir_count : 1) * sizeof(ScanDir*));
+    uint32_t i = 0, j = 0, n = 0;
+    while (i < d->dir_count || j < l->dir_count) {
+        int c = i == d->dir_count ? 1 : j == l->dir_count ? -1 : strcmp(d->dirs[i]->name, l->dirs[j]);
+        if (c < 0) {
+            report_removed(d->dirs[i], visit, data);
+            free_dir(d->dirs[i]);
+        } else if (c > 0) {
+            dirs[n++] = new_dir(join_path(d->path, l->dirs[j]));
+        } else {
+            dirs[n++] = d->dirs[i];
+        }
+        if (c <= 0)
+            i++;
+        if (c >= 0)
+            free(l->dirs[j++]);
+    }
+    free(l->dirs);
+    free(d->dirs);
+    d->dirs = dirs;
+    d->dir_count = n;
+}
+
+// returns false if the directory was seen before in this scan
+static bool visit_once(Visited* v, const struct stat* st)
+{
+    for (uint32_t i = 0; i < v->count; i++)
+        if (v->ids[i].dev == st->st_dev && v->ids[i].ino == st->st_ino)
+            return false;
+    if (v->count == v->cap) {
+        v->cap = v->cap ? v->cap * 2 : 32;
+        v->ids = realloc(v->ids, v->cap * sizeof(v->ids[0]));
+    }
+    v->ids[v->count].dev = st->st_dev;
+    v->ids[v->count].ino = st->st_ino;
+    v->count++;
+    return true;
+}
+
+static void update_dir(ScanDir* d, unsigned depth, const char* suffix, Visited* visited, ScanVisit visit, void* data)
+{
+    struct stat st;
+    // a directory already scanned under another path counts as missing here
+    if (stat(d->path, &st) || !S_ISDIR(st.st_mode) || !visit_once(visited, &st)) {
+        if (d->exists)
+            report_removed(d, visit, data);
+        clear_dir(d);
+        d->exists = false;
+        return;
+    }
+    bool changed = !d->exists || st.st_mtim.tv_sec != d->mtime.tv_sec || st.st_mtim.tv_nsec != d->mtime.tv_nsec;
+    int fd = changed ? open(d->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC) : -1;
+    if (fd >= 0) {
+        Listing l = {0};
+        if (read_listing(fd, suffix, depth < SCAN_MAX_DEPTH, &l)) {
+            if (!d->exists)
+                visit(SCAN_DIR, d->path, 0, data);
+            merge_files(d, &l, visit, data);
+            merge_dirs(d, &l, visit, data);
+            d->exists = true;
+            d->mtime = st.st_mtim; // from before reading, a change while reading is seen next time
+        } else {
+            for (uint32_t i = 0; i < l.file_count; i++)
+                free(l.files[i].name);
+            for (uint32_t i = 0; i < l.dir_count; i++)
+                free(l.dirs[i]);
+            free(l.files);
+            free(l.dirs);
+        }
+        close(fd);
+    }
+    // a change below d doesn't touch the mtime of d
+    for (uint32_t i = 0; i < d->dir_count; i++)
+        update_dir(d->dirs[i], depth + 1, suffix, visited, visit, data);
+}
+
+void scan_update(ScanTree* tree, const char* const* roots, uint32_t root_count, const char* suffix,
+                 ScanVisit visit, void* data)
+{
+    ScanDir** dirs = calloc(root_count ? root_count : 1, sizeof(ScanDir*));
+    uint32_t n = 0;
+    for (uint32_t r = 0; r < root_count; r++) {
+        bool duplicate = false;
+        for (uint32_t i = 0; i < n; i++)
+            duplicate |= !strcmp(dirs[i]->path, roots[r]);
+        if (duplicate)
+            continue;
+        ScanDir* d = NULL;
+        for (uint32_t i = 0; i < tree->root_count && !d; i++) {
+            if (tree->roots[i] && !strcmp(tree->roots[i]->path, roots[r])) {
+                d = tree->roots[i];
+                tree->roots[i] = NULL; // moved
+            }
+        }
+        dirs[n++] = d ? d : new_dir(strdup(roots[r]));
+    }
+    for (uint32_t i = 0; i < tree->root_count; i++)
+        if (tree->roots[i])
+            free_dir(tree->roots[i]);
+    free(tree->roots);
+    tree->roots = dirs;
+    tree->root_count = n;
+
+    Visited visited = {NULL, 0, 0};
+    for (uint32_t i = 0; i < n; i++)
+        update_dir(dirs[i], 0, suffix, &visited, visit, data);
+    free(visited.ids);
+}
+
+void scan_free(ScanTree* tree)
+{
+    for (uint32_t i = 0; i < tree->root_count; i++)
+        free_dir(tree->roots[i]);
+    free(tree->roots);
+    memset(tree, 0, sizeof(ScanTree));
+}
@@ -0,0 +1,45 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+// directory trees of files with a given suffix, like the XDG applications dirs
+// each directory keeps its mtime and listing, so a rescan only reads the
+// directories that changed and costs one stat for every other one
+
+#define SCAN_MAX_DEPTH      8       // deeper directories are not read
+
+typedef enum {
+    SCAN_FILE,                      // new, or its mtime changed
+    SCAN_REMOVED,                   // gone since the last scan, mtime is 0
+    SCAN_DIR,                       // a directory that exists now but didn't before
+} ScanEvent;
+
+typedef void (*ScanVisit)(ScanEvent event, const char* path, time_t mtime, void* data);
+
+typedef struct ScanDir ScanDir;
+
+typedef struct {
+    ScanDir**   roots;
+    uint32_t    root_count;
+} ScanTree;
+
+// rescan roots and their subdirectories, visit is called for every change to a file
+// ending in suffix (case insensitive), the first scan reports every file
+// a directory reached twice through symlinks is only scanned under its first path, depth first
+// roots that are not passed again are dropped without events
+void scan_update(ScanTree* tree, const char* const* roots, uint32_t root_count, const char* suffix,
+                 ScanVisit visit, void* data);
+
+void scan_free(ScanTree* tree);
+
+#endif
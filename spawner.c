@@ -0,0 +1,243 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#define _GNU_SOURCE // POSIX_SPAWN_SETSID
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "spawner.h"
+
+// request layout: header, then size bytes of zero terminated strings,
+// the working directory followed by argc arguments and envc variables
+// both ends are the same binary, so the header is in native byte order
+
+typedef struct {
+    uint32_t    size;
+    uint32_t    argc;
+    uint32_t    envc;
+} Header;
+
+extern char** environ;
+
+static int      helper_fd = -1;     // our end of the socket pair
+
+//------------------------------------------
+// helper process
+
+static bool read_all(int fd, void* data, size_t len)
+{
+    char* p = data;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// split the strings into list, returns the position after the last one or NULL if they don't fit
+static char* split_strings(char* p, char* end, char** list, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        char* z = p < end ? memchr(p, 0, end - p) : NULL;
+        if (!z)
+            return NULL;
+        list[i] = p;
+        p = z + 1;
+    }
+    list[count] = NULL;
+    return p;
+}
+
+static bool spawn(char* const* argv, char* const* env, const char* dir)
+{
+    int cwd = -1;
+    if (*dir) {
+        cwd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (cwd < 0 || chdir(dir)) {
+            fprintf(stderr, "fehlstart: can't change to %s for %s\n", dir, argv[0]);
+            if (cwd >= 0)
+                close(cwd);
+            return false;
+        }
+    }
+
+    // children get the signal handling the helper changed for itself back
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigaddset(&signals, SIGCHLD);
+    sigaddset(&signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_SETSID
+    flags |= POSIX_SPAWN_SETSID; // "detach" from fehlstart, the helper's own setsid covers older libcs
+#endif
+    posix_spawnattr_setflags(&attr, flags);
+
+    pid_t pid;
+    int err = posix_spawnp(&pid, argv[0], NULL, &attr, argv, env);
+    if (err)
+        fprintf(stderr, "fehlstart: can't start %s: %s\n", argv[0], strerror(err));
+    posix_spawnattr_destroy(&attr);
+
+    if (cwd >= 0) {
+        if (fchdir(cwd)) {};    // shut up gcc warning
+        close(cwd);
+    }
+    return err == 0;
+}
+
+// runs until fehlstart closes its end of the socket
+static void helper_main(int fd)
+{
+    setsid();
+    signal(SIGCHLD, SIG_IGN);   // let the kernel reap the children
+    signal(SIGPIPE, SIG_IGN);
+    char* data = NULL;
+    char** list = NULL;
+    Header h;
+    while (read_all(fd, &h, sizeof(h))) {
+        if (h.size > SPAWNER_MAX_REQUEST || h.argc == 0 || h.argc >= h.size || h.envc >= h.size - h.argc)
+            break;              // out of sync, nothing sensible to do
+        data = realloc(data, h.size);
+        list = realloc(list, (h.argc + h.envc + 2) * sizeof(char*));
+        if (!data || !list || !read_all(fd, data, h.size))
+            break;
+        char* end = data + h.size;
+        char* dir = data;
+        char** argv = list;
+        char** env = list + h.argc + 1;
+        char* p = memchr(data, 0, h.size);
+        p = p ? split_strings(p + 1, end, argv, h.argc) : NULL;
+        p = p ? split_strings(p, end, env, h.envc) : NULL;
+        if (p)
+            spawn(argv, env, dir);
+    }
+    free(data);
+    free(list);
+}
+
+//------------------------------------------
+// fehlstart side
+
+bool spawner_start(void)
+{
+    int fds[2];
+    // a socket pair instead of a pipe, writes to a dead helper fail instead of raising SIGPIPE
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds))
+        return false;
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        helper_main(fds[1]);
+        _exit(EXIT_SUCCESS);
+    }
+    close(fds[1]);
+    helper_fd = fds[0];
+    return true;
+}
+
+void spawner_stop(void)
+{
+    if (helper_fd >= 0)
+        close(helper_fd);
+    helper_fd = -1;
+}
+
+static bool write_all(int fd, const char* data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static uint32_t count_strings(char* const* list, size_t* size)
+{
+    uint32_t count = 0;
+    for (; list[count]; count++)
+        *size += strlen(list[count]) + 1;
+    return count;
+}
+
+static char* append_string(char* p, const char* s)
+{
+    size_t len = strlen(s) + 1;
+    memcpy(p, s, len);
+    return p + len;
+}
+
+// header and strings in one buffer, so the request goes out in a single write
+static char* build_request(char* const* argv, char* const* env, const char* dir, size_t* len)
+{
+    size_t size = strlen(dir) + 1;
+    uint32_t argc = count_strings(argv, &size);
+    uint32_t envc = count_strings(env, &size);
+    if (size > SPAWNER_MAX_REQUEST)
+        return NULL;
+
+    Header h = {size, argc, envc};
+    char* buffer = malloc(sizeof(h) + size);
+    if (!buffer)
+        return NULL;
+    memcpy(buffer, &h, sizeof(h));
+    char* p = append_string(buffer + sizeof(h), dir);
+    for (uint32_t i = 0; i < argc; i++)
+        p = append_string(p, argv[i]);
+    for (uint32_t i = 0; i < envc; i++)
+        p = append_string(p, env[i]);
+    *len = sizeof(h) + size;
+    return buffer;
+}
+
+bool spawner_request(char* const* argv, char* const* env, const char* dir)
+{
+    if (!argv || !argv[0])
+        return false;
+    env = env ? env : environ;
+    dir = dir ? dir : "";
+    if (helper_fd >= 0) {
+        size_t len = 0;
+        char* request = build_request(argv, env, dir, &len);
+        if (!request)
+            return false;
+        bool ok = write_all(helper_fd, request, len);
+        free(request);
+        if (ok)
+            return true;
+        spawner_stop(); // the helper is gone
+    }
+    // a new helper would be forked from the gui with all its threads and memory,
+    // posix_spawn from here copies neither, the working directory changes for a moment
+    return spawn(argv, env, dir);
+}
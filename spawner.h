@@ -0,0 +1,32 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#ifndef SPAWNER_H
+#define SPAWNER_H
+
+#include <stdbool.h>
+
+// programs are started by a helper process that is forked while fehlstart
+// is still small, so launching never copies the gui's address space
+// the helper reads requests from a socket and starts them with posix_spawn
+
+#define SPAWNER_MAX_REQUEST   (256 * 1024)
+
+// fork the helper, call early before threads and the x connection exist
+// returns false if the helper couldn't be started
+bool spawner_start(void);
+
+// stop the helper, programs it started keep running
+void spawner_stop(void);
+
+// start argv[0] from PATH in its own session, the call doesn't wait for it
+// env is NULL for the current environment, dir NULL or "" for the current directory
+// without a helper, or once it died, programs are started with posix_spawn directly
+// and dir is entered by the calling process for a moment, not thread safe
+bool spawner_request(char* const* argv, char* const* env, const char* dir);
+
+#endif
@@ -9,6 +9,7 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include "str.h"
+#include "arena.h"
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
@@ -87,6 +88,27 @@ String str_join_path(String prefix, String suffix)
     return path;
 }
 
+String str_arena_duplicate(Arena* arena, String s)
+{
+    if (s.len == 0)
+        return STR_S("");
+    char* str = arena_alloc(arena, s.len + 1);
+    memcpy(str, s.str, s.len);
+    return (String) {str, s.len, false};
+}
+
+String str_arena_join_path(Arena* arena, String prefix, String suffix)
+{
+    bool slash = prefix.len == 0 || prefix.str[prefix.len - 1] != '/';
+    uint32_t len = prefix.len + slash + suffix.len;
+    char* str = arena_alloc(arena, len + 1);
+    memcpy(str, prefix.str, prefix.len);
+    if (slash)
+        str[prefix.len] = '/';
+    memcpy(str + prefix.len + slash, suffix.str, suffix.len);
+    return (String) {str, len, false};
+}
+
 //------------------------------------------
 
 String str_substring(String s, uint32_t begin, uint32_t length)
@@ -106,35 +128,158 @@ inline static int cdiff_i(char a, char b)
     return tolower(a) - tolower(b);
 }
 
-static uint32_t str_find_first_impl(String s, String what, int (*dif) (char, char))
+// substring search
+// candidates are positions where the first and the last byte of what match,
+// the vector versions test 16 or 32 of them at once and verify the rest.
+// case folding is ascii only, so it can be done with vector instructions
+
+inline static char fold(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static bool equal_n(const char* a, const char* b, uint32_t n, bool fold_case)
+{
+    if (!fold_case)
+        return !memcmp(a, b, n);
+    for (uint32_t i = 0; i < n; i++)
+        if (fold(a[i]) != fold(b[i]))
+            return false;
+    return true;
+}
+
+// also used for the tails of the vectorized versions
+static uint32_t find_scalar(String s, String what, uint32_t begin, bool fold_case)
+{
+    for (uint32_t i = begin; i + what.len <= s.len; i++)
+        if (equal_n(s.str + i, what.str, what.len, fold_case))
+            return i;
+    return STR_END;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STR_SIMD
+
+#include <immintrin.h>
+
+// adds 0x20 to 'A'..'Z', bytes above 0x7f compare as negative and are left alone
+__attribute__((target("sse2")))
+inline static __m128i fold16(__m128i v)
+{
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2")))
+inline static __m256i fold32(__m256i v)
+{
+    __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+    return _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+// checks the candidates in mask, bit n stands for position begin + n
+static uint32_t verify(String s, String what, uint32_t begin, uint32_t mask, bool fold_case)
 {
-    uint32_t wi = 0;
-    for (uint32_t i = 0; i < s.len && wi < what.len; i++) {
-        wi = !dif(s.str[i], what.str[wi]) ? wi + 1 : 0;
-        if (wi == what.len)
-            return i - what.len + 1;
+    uint32_t middle = what.len > 2 ? what.len - 2 : 0;
+    for (; mask; mask &= mask - 1) {
+        uint32_t i = begin + __builtin_ctz(mask);
+        if (equal_n(s.str + i + 1, what.str + 1, middle, fold_case))
+            return i;
     }
     return STR_END;
 }
 
+__attribute__((target("sse2")))
+static uint32_t find_sse2(String s, String what, uint32_t begin, bool fold_case)
+{
+    const uint32_t n = what.len;
+    const __m128i first = _mm_set1_epi8(fold_case ? fold(what.str[0]) : what.str[0]);
+    const __m128i last = _mm_set1_epi8(fold_case ? fold(what.str[n - 1]) : what.str[n - 1]);
+    uint32_t i = begin;
+    for (; i + n - 1 + 16 <= s.len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(s.str + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(s.str + i + n - 1));
+        if (fold_case) {
+            a = fold16(a);
+            b = fold16(b);
+        }
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        uint32_t pos = verify(s, what, i, mask, fold_case);
+        if (pos != STR_END)
+            return pos;
+    }
+    return find_scalar(s, what, i, fold_case);
+}
+
+__attribute__((target("avx2")))
+static uint32_t find_avx2(String s, String what, uint32_t begin, bool fold_case)
+{
+    const uint32_t n = what.len;
+    const __m256i first = _mm256_set1_epi8(fold_case ? fold(what.str[0]) : what.str[0]);
+    const __m256i last = _mm256_set1_epi8(fold_case ? fold(what.str[n - 1]) : what.str[n - 1]);
+    uint32_t i = begin;
+    for (; i + n - 1 + 32 <= s.len; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(s.str + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(s.str + i + n - 1));
+        if (fold_case) {
+            a = fold32(a);
+            b = fold32(b);
+        }
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+        uint32_t pos = verify(s, what, i, mask, fold_case);
+        if (pos != STR_END)
+            return pos;
+    }
+    return find_sse2(s, what, i, fold_case);
+}
+#endif
+
+static uint32_t find_dispatch(String s, String what, uint32_t begin, bool fold_case);
+
+// picked on first use, depending on what the cpu supports
+static uint32_t (*find_impl)(String, String, uint32_t, bool) = find_dispatch;
+
+static uint32_t find_dispatch(String s, String what, uint32_t begin, bool fold_case)
+{
+    uint32_t (*impl)(String, String, uint32_t, bool) = find_scalar;
+#ifdef STR_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        impl = find_avx2;
+    else if (__builtin_cpu_supports("sse2"))
+        impl = find_sse2;
+#endif
+    find_impl = impl;
+    return impl(s, what, begin, fold_case);
+}
+
+static uint32_t str_find_first_impl(String s, String what, bool fold_case)
+{
+    if (what.len == 0 || what.len > s.len)
+        return STR_END;
+    return find_impl(s, what, 0, fold_case);
+}
+
 uint32_t str_find_first(String s, String what)
 {
-    return str_find_first_impl(s, what, cdiff_s);
+    return str_find_first_impl(s, what, false);
 }
 
 uint32_t str_find_first_i(String s, String what)
 {
-    return str_find_first_impl(s, what, cdiff_i);
+    return str_find_first_impl(s, what, true);
 }
 
 bool str_contains(String s, String what)
 {
-    return str_find_first_impl(s, what, cdiff_s) != STR_END;
+    return str_find_first_impl(s, what, false) != STR_END;
 }
 
 bool str_contains_i(String s, String what)
 {
-    return str_find_first_impl(s, what, cdiff_i) != STR_END;
+    return str_find_first_impl(s, what, true) != STR_END;
 }
 
 //------------------------------------------
@@ -5,6 +5,9 @@
 *   copyright 2013 maep and contributors
 */
 
+#ifndef STR_H
+#define STR_H
+
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -53,6 +56,12 @@ String str_create(uint32_t len);
 // must be freed with str_free()
 String str_duplicate(String s);
 
+// arena variants of str_duplicate and str_join_path, memory belongs to the arena
+// str_free() has no effect on them, see arena.h
+struct Arena;
+String str_arena_duplicate(struct Arena* arena, String s);
+String str_arena_join_path(struct Arena* arena, String a, String b);
+
 // concatinate (append) two strings
 // a and b remain unchanged
 // must be freed with str_free()
@@ -100,3 +109,4 @@ bool str_equal_i(String a, String b);
 // converts string to lowercase, returned string is same as s
 String str_to_lower(String s);
 
+#endif
@@ -0,0 +1,85 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#include <string.h>
+#include "arena.h"
+#include "trie.h"
+
+typedef struct TrieValue {
+    uint32_t            value;
+    struct TrieValue*   next;
+} TrieValue;
+
+struct TrieNode {
+    TrieNode*   child;              // first child, children are sorted by c
+    TrieNode*   next;               // next sibling
+    TrieValue*  values;             // of the key ending here
+    uint32_t    begin;              // range of the subtree in Trie.values
+    uint32_t    end;
+    char        c;
+};
+
+void trie_init(Trie* t, Arena* arena)
+{
+    *t = (Trie) {arena, arena_alloc(arena, sizeof(TrieNode)), NULL, 0};
+}
+
+static TrieNode* get_child(Arena* arena, TrieNode* node, char c)
+{
+    TrieNode** link = &node->child;
+    while (*link && (unsigned char)(*link)->c < (unsigned char)c)
+        link = &(*link)->next;
+    if (*link && (*link)->c == c)
+        return *link;
+    TrieNode* child = arena_alloc(arena, sizeof(TrieNode));
+    child->c = c;
+    child->next = *link;
+    *link = child;
+    return child;
+}
+
+void trie_add(Trie* t, String key, uint32_t value)
+{
+    TrieNode* node = t->root;
+    for (uint32_t i = 0; i < key.len; i++)
+        node = get_child(t->arena, node, key.str[i]);
+    TrieValue* v = arena_alloc(t->arena, sizeof(TrieValue));
+    v->value = value;
+    v->next = node->values;
+    node->values = v;
+    t->count++;
+}
+
+// depth first, so a subtree is a contiguous range, recursion depth is the longest key
+static void lay_out(TrieNode* node, uint32_t* values, uint32_t* n)
+{
+    node->begin = *n;
+    for (TrieValue* v = node->values; v; v = v->next)
+        values[(*n)++] = v->value;
+    for (TrieNode* child = node->child; child; child = child->next)
+        lay_out(child, values, n);
+    node->end = *n;
+}
+
+void trie_finish(Trie* t)
+{
+    uint32_t n = 0;
+    t->values = arena_alloc(t->arena, (t->count ? t->count : 1) * sizeof(uint32_t));
+    lay_out(t->root, t->values, &n);
+}
+
+const uint32_t* trie_find_prefix(const Trie* t, String prefix, uint32_t* count)
+{
+    const TrieNode* node = t->root;
+    for (uint32_t i = 0; node && i < prefix.len; i++) {
+        node = node->child;
+        while (node && node->c != prefix.str[i])
+            node = node->next;
+    }
+    *count = node ? node->end - node->begin : 0;
+    return node ? t->values + node->begin : t->values;
+}
@@ -0,0 +1,38 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#ifndef TRIE_H
+#define TRIE_H
+
+#include "str.h"
+
+// prefix tree from keys to uint32 values, built once and then only read
+// after trie_finish() the values of every subtree lie next to each other,
+// so all values whose key starts with a prefix come from one walk down
+
+struct Arena;
+typedef struct TrieNode TrieNode;
+
+typedef struct {
+    struct Arena* arena;            // nodes and values live here
+    TrieNode*   root;
+    uint32_t*   values;             // in key order, set by trie_finish()
+    uint32_t    count;
+} Trie;
+
+void trie_init(Trie* t, struct Arena* arena);
+
+// keys are case sensitive, a key may be added with several values
+void trie_add(Trie* t, String key, uint32_t value);
+
+// lay out the values, no adds afterwards
+void trie_finish(Trie* t);
+
+// values of all keys that start with prefix, count is set to their number
+const uint32_t* trie_find_prefix(const Trie* t, String prefix, uint32_t* count);
+
+#endif
@@ -0,0 +1,108 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include "trigram.h"
+
+#define MAX_QUERY_GRAMS     32      // longer queries only use their first trigrams
+
+static const CorpusField fields[] = {CORPUS_NAME, CORPUS_EXEC};
+
+static uint32_t bucket(const char* s)
+{
+    uint32_t v = (uint32_t)(unsigned char)s[0] << 16 | (uint32_t)(unsigned char)s[1] << 8 | (unsigned char)s[2];
+    return (v * 2654435761u) >> (32 - TRIGRAM_BITS);
+}
+
+// visit every bucket of entry id once, ids arrive in ascending order and last holds the previous one
+// without ids the postings are counted into count[b + 1], with ids they are written at pos[b]
+static void add_entry(const Corpus* c, uint32_t id, uint32_t* last, uint32_t* count, uint32_t* pos, uint32_t* ids)
+{
+    for (unsigned f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+        String s = corpus_get(c, id, fields[f]);
+        for (uint32_t i = 0; i + 3 <= s.len; i++) {
+            uint32_t b = bucket(s.str + i);
+            if (last[b] == id + 1)
+                continue;
+            last[b] = id + 1;
+            if (ids)
+                ids[pos[b]++] = id;
+            else
+                count[b + 1]++;
+        }
+    }
+}
+
+void trigram_build(TrigramIndex* t, const Corpus* c)
+{
+    t->offset = calloc(TRIGRAM_BUCKETS + 1, sizeof(uint32_t));
+    uint32_t* last = calloc(TRIGRAM_BUCKETS, sizeof(uint32_t));
+    uint32_t* pos = malloc(TRIGRAM_BUCKETS * sizeof(uint32_t));
+    // count the postings of each bucket, then fill them in at their offsets
+    for (uint32_t id = 0; id < c->count; id++)
+        add_entry(c, id, last, t->offset, NULL, NULL);
+    for (uint32_t b = 0; b < TRIGRAM_BUCKETS; b++)
+        t->offset[b + 1] += t->offset[b];
+    t->ids = malloc((t->offset[TRIGRAM_BUCKETS] + 1) * sizeof(uint32_t));
+
+    memcpy(pos, t->offset, TRIGRAM_BUCKETS * sizeof(uint32_t));
+    memset(last, 0, TRIGRAM_BUCKETS * sizeof(uint32_t));
+    for (uint32_t id = 0; id < c->count; id++)
+        add_entry(c, id, last, NULL, pos, t->ids);
+    free(pos);
+    free(last);
+}
+
+void trigram_free(TrigramIndex* t)
+{
+    free(t->offset);
+    free(t->ids);
+    memset(t, 0, sizeof(TrigramIndex));
+}
+
+static uint32_t posting_count(const TrigramIndex* t, uint32_t b)
+{
+    return t->offset[b + 1] - t->offset[b];
+}
+
+// keep the ids in out that are also in the posting list of b, both are ascending
+static uint32_t intersect(const TrigramIndex* t, uint32_t b, uint32_t* out, uint32_t count)
+{
+    const uint32_t* p = t->ids + t->offset[b];
+    const uint32_t* end = t->ids + t->offset[b + 1];
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count && p < end; i++) {
+        while (p < end && *p < out[i])
+            p++;
+        if (p < end && *p == out[i])
+            out[n++] = out[i];
+    }
+    return n;
+}
+
+uint32_t trigram_candidates(const TrigramIndex* t, String query, uint32_t* out)
+{
+    uint32_t buckets[MAX_QUERY_GRAMS];
+    uint32_t count = 0;
+    for (uint32_t i = 0; i + 3 <= query.len && count < MAX_QUERY_GRAMS; i++)
+        buckets[count++] = bucket(query.str + i);
+    if (count == 0 || !t->offset)
+        return 0;
+
+    // start with the shortest list, the result can only shrink
+    uint32_t shortest = 0;
+    for (uint32_t i = 1; i < count; i++)
+        if (posting_count(t, buckets[i]) < posting_count(t, buckets[shortest]))
+            shortest = i;
+    uint32_t n = posting_count(t, buckets[shortest]);
+    memcpy(out, t->ids + t->offset[buckets[shortest]], n * sizeof(uint32_t));
+    for (uint32_t i = 0; i < count && n > 0; i++)
+        if (buckets[i] != buckets[shortest])
+            n = intersect(t, buckets[i], out, n);
+    return n;
+}
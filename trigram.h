@@ -0,0 +1,35 @@
+/*
+*   fehlstart - a small launcher written in c99
+*   this source is published under the GPLv3 license.
+*   get the license from: http://www.gnu.org/licenses/gpl-3.0.txt
+*   copyright 2013 maep and contributors
+*/
+
+#ifndef TRIGRAM_H
+#define TRIGRAM_H
+
+#include "corpus.h"
+
+// inverted index from the trigrams of name and exec to corpus ids
+// trigrams are hashed into buckets, so a candidate may still not contain
+// the query and has to be verified, but every entry that does is found
+
+#define TRIGRAM_BITS        16
+#define TRIGRAM_BUCKETS     (1u << TRIGRAM_BITS)
+
+typedef struct {
+    uint32_t*   offset;             // TRIGRAM_BUCKETS + 1, postings of bucket b are ids[offset[b]..offset[b + 1]]
+    uint32_t*   ids;                // ascending within a bucket
+} TrigramIndex;
+
+// index the name and exec fields of all entries in c
+void trigram_build(TrigramIndex* t, const Corpus* c);
+
+void trigram_free(TrigramIndex* t);
+
+// ids of the entries that may contain query as substring, ascending
+// query must be lowercase and at least 3 characters, out needs room for every entry
+// returns the number of candidates
+uint32_t trigram_candidates(const TrigramIndex* t, String query, uint32_t* out);
+
+#endif